@@ -0,0 +1,31 @@
+// Replacement global operator new and delete that count allocations. They
+// are defined out of line in their own translation unit, so callers see an
+// ordinary new/delete pair instead of an inlined malloc() matched against
+// free().
+#include "allocation_counter.hpp"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+size_t allocations = 0;
+
+} // namespace
+
+size_t allocationCount() {
+    return allocations;
+}
+
+void* operator new(size_t size) {
+    ++allocations;
+    if(void* ptr = std::malloc(size))
+        return ptr;
+    throw std::bad_alloc();
+}
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+void operator delete(void* ptr, size_t /*size*/) noexcept {
+    std::free(ptr);
+}
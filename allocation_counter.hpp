@@ -0,0 +1,7 @@
+#pragma once
+#include <cstddef>
+
+// Number of global operator new calls so far. Counted by the replacement
+// operators in allocation_counter.cpp, which the test and the benchmark
+// link in.
+size_t allocationCount();
@@ -0,0 +1,48 @@
+#pragma once
+#include <cmath>
+
+// Helpers shared by command_line_bench, command_line_getopt_bench and
+// command_line_fuzz.
+
+// Flags 'a' to 'z' of the benchmark schemas, with long names "flag-a" to
+// "flag-z": specs for CommandLineParser and long names for getopt_long.
+#define BENCH_FLAGS(FLAG)                                                     \
+    FLAG(a), FLAG(b), FLAG(c), FLAG(d), FLAG(e), FLAG(f), FLAG(g), FLAG(h),   \
+        FLAG(i), FLAG(j), FLAG(k), FLAG(l), FLAG(m), FLAG(n), FLAG(o),        \
+        FLAG(p), FLAG(q), FLAG(r), FLAG(s), FLAG(t), FLAG(u), FLAG(v),        \
+        FLAG(w), FLAG(x), FLAG(y), FLAG(z)
+#define BENCH_FLAG_SPEC(c) "flag-" #c "," #c
+#define BENCH_FLAG_NAME(c) "flag-" #c
+inline constexpr const char* benchFlagSpecs[26] = {
+    BENCH_FLAGS(BENCH_FLAG_SPEC)};
+inline constexpr const char* benchFlagNames[26] = {
+    BENCH_FLAGS(BENCH_FLAG_NAME)};
+#undef BENCH_FLAG_NAME
+#undef BENCH_FLAG_SPEC
+#undef BENCH_FLAGS
+
+// Fits time = c * size^k by least squares on the log scale. Linear paths
+// measure close to 1, a quadratic one close to 2.
+class GrowthFit {
+public:
+    void add(double size, double seconds) {
+        double x = std::log(size);
+        double y = std::log(seconds);
+        sumX_ += x;
+        sumY_ += y;
+        sumXX_ += x * x;
+        sumXY_ += x * y;
+        ++count_;
+    }
+    double exponent() const {
+        return (count_ * sumXY_ - sumX_ * sumY_)
+               / (count_ * sumXX_ - sumX_ * sumX_);
+    }
+
+private:
+    double sumX_ = 0;
+    double sumY_ = 0;
+    double sumXX_ = 0;
+    double sumXY_ = 0;
+    int count_ = 0;
+};
@@ -0,0 +1,520 @@
+// Benchmark of CommandLineParser::parse() and getHelp() on synthetic schemas
+// and command lines. Each case prints the time per argument, allocations
+// per parse and, where perf_event_open is permitted, cycles, instructions
+// and branch misses per argument. Inputs are generated from fixed seeds, so
+// runs are comparable between builds.
+//
+// With --check-scaling it instead times worst case command line shapes of
+// growing size, fits the growth exponent and fails if any shape grows
+// faster than linearly in the command line length. With --conversions it
+// times the integer conversions against std::from_chars.
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+#include "allocation_counter.hpp"
+#include "bench_util.hpp"
+#include "command_line_parser.hpp"
+
+#if __has_include(<linux/perf_event.h>)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+using namespace univang;
+
+// Hardware counters of the calling thread, user space only.
+class PerfCounters {
+public:
+    static constexpr size_t count = 3;
+
+    PerfCounters() {
+#if __has_include(<linux/perf_event.h>)
+        const uint64_t configs[count] = {
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_BRANCH_MISSES};
+        for(size_t i = 0; i < count; ++i) {
+            perf_event_attr attr{};
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = configs[i];
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fds_[i] = static_cast<int>(
+                syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+#endif
+    }
+    ~PerfCounters() {
+#if __has_include(<linux/perf_event.h>)
+        for(auto fd : fds_) {
+            if(fd >= 0)
+                close(fd);
+        }
+#endif
+    }
+    bool available() const {
+        return fds_[0] >= 0;
+    }
+    void start() {
+#if __has_include(<linux/perf_event.h>)
+        for(auto fd : fds_) {
+            if(fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+    // Cycles, instructions and branch misses since start(), -1 if unknown.
+    std::array<double, count> stop() {
+        std::array<double, count> result;
+        result.fill(-1);
+#if __has_include(<linux/perf_event.h>)
+        for(size_t i = 0; i < count; ++i) {
+            uint64_t value = 0;
+            if(fds_[i] < 0)
+                continue;
+            ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+            if(read(fds_[i], &value, sizeof(value)) == sizeof(value))
+                result[i] = static_cast<double>(value);
+        }
+#endif
+        return result;
+    }
+
+private:
+    int fds_[count] = {-1, -1, -1};
+};
+
+// optionCount named int options, 26 short flags, a list and optionally a
+// positional catch-all. Without one, a list takes all values that follow.
+struct Schema {
+    std::vector<std::string> names;
+    std::vector<int> values;
+    std::array<bool, 26> flags{};
+    std::vector<int> list;
+    std::vector<std::string_view> files;
+    CommandLineParser parser;
+
+    Schema(size_t optionCount, bool positional)
+        : names(optionCount), values(optionCount) {
+        for(size_t i = 0; i < 26; ++i)
+            parser.addFlag(flags[i], benchFlagSpecs[i], "flag");
+        for(size_t i = 0; i < optionCount; ++i) {
+            names[i] = "option-" + std::to_string(i);
+            parser.add(values[i], names[i], "int value");
+        }
+        parser.add(list, "list,L", "ints");
+        if(positional)
+            parser.add(files, ",,file", "files", -1);
+    }
+};
+
+enum class Shape { longNames, clusters, positional, lists };
+
+const char* shapeName(Shape shape) {
+    switch(shape) {
+    case Shape::longNames:
+        return "long";
+    case Shape::clusters:
+        return "cluster";
+    case Shape::positional:
+        return "positional";
+    case Shape::lists:
+        return "list";
+    }
+    return "";
+}
+
+std::vector<std::string> makeArgs(
+    Shape shape, size_t optionCount, size_t tokenCount) {
+    std::mt19937 random(static_cast<unsigned>(tokenCount * 31 + optionCount));
+    std::vector<std::string> args;
+    args.reserve(tokenCount);
+    switch(shape) {
+    case Shape::longNames:
+        while(args.size() < tokenCount) {
+            auto index = random() % optionCount;
+            args.push_back(
+                "--option-" + std::to_string(index) + "="
+                + std::to_string(random() % 100000));
+        }
+        break;
+    case Shape::clusters:
+        while(args.size() < tokenCount) {
+            std::string arg = "-";
+            for(size_t i = 0; i < 8; ++i)
+                arg += static_cast<char>('a' + random() % 26);
+            args.push_back(std::move(arg));
+        }
+        break;
+    case Shape::positional:
+        while(args.size() < tokenCount)
+            args.push_back("file" + std::to_string(random() % 100000));
+        break;
+    case Shape::lists:
+        args.push_back("--list");
+        while(args.size() < tokenCount)
+            args.push_back(std::to_string(random() % 100000));
+        break;
+    }
+    return args;
+}
+
+void runCase(
+    Schema& schema, size_t optionCount, Shape shape, size_t tokenCount,
+    double minSeconds, PerfCounters& counters) {
+    auto args = makeArgs(shape, optionCount, tokenCount);
+    std::vector<char*> argv;
+    argv.reserve(args.size() + 1);
+    argv.push_back(const_cast<char*>("bench"));
+    for(auto& arg : args)
+        argv.push_back(arg.data());
+    int argc = static_cast<int>(argv.size());
+    // Warm up, and let lists reach their capacity.
+    schema.parser.reset();
+    if(!schema.parser.parse(argc, argv.data())) {
+        std::cerr << "parse failed: " << schema.parser.error() << '\n';
+        std::exit(1);
+    }
+    size_t iterations = 0;
+    size_t allocated = allocationCount();
+    double seconds = 0;
+    counters.start();
+    auto start = std::chrono::steady_clock::now();
+    // reset() is part of reusing a parser and is timed too. It only visits
+    // the flag and list options and clears one parsed mark byte per option.
+    do {
+        schema.parser.reset();
+        schema.parser.parse(argc, argv.data());
+        ++iterations;
+        seconds = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+    } while(seconds < minSeconds || iterations < 3);
+    auto events = counters.stop();
+    double argCount = static_cast<double>(iterations) * tokenCount;
+    std::cout << optionCount << '\t' << tokenCount << '\t' << shapeName(shape)
+              << '\t' << seconds * 1e9 / argCount << '\t'
+              << static_cast<double>(allocationCount() - allocated)
+                     / iterations;
+    for(auto value : events) {
+        std::cout << '\t';
+        if(value < 0)
+            std::cout << '-';
+        else
+            std::cout << value / argCount;
+    }
+    std::cout << '\n';
+}
+
+void runHelp(Schema& schema, size_t optionCount, double minSeconds) {
+    size_t iterations = 0;
+    size_t bytes = 0;
+    double seconds = 0;
+    auto start = std::chrono::steady_clock::now();
+    do {
+        bytes += schema.parser.getHelp().size();
+        ++iterations;
+        seconds = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+    } while(seconds < minSeconds || iterations < 3);
+    std::cout << optionCount << "\tgetHelp\t"
+              << seconds * 1e9 / iterations / schema.values.size()
+              << " ns/option\t" << bytes / iterations << " bytes\n";
+}
+
+// Command lines that would expose superlinear paths in parse(): unknown
+// options skipped one by one, long flag clusters, names sharing long
+// prefixes with the registered ones, one huge list run and one huge
+// "--name=value" argument.
+enum class WorstCase {
+    unknown,
+    bigCluster,
+    clusters,
+    nearNames,
+    listRun,
+    longValue
+};
+
+const char* worstCaseName(WorstCase shape) {
+    switch(shape) {
+    case WorstCase::unknown:
+        return "skip-unknown";
+    case WorstCase::bigCluster:
+        return "one-cluster";
+    case WorstCase::clusters:
+        return "clusters";
+    case WorstCase::nearNames:
+        return "near-names";
+    case WorstCase::listRun:
+        return "list-run";
+    case WorstCase::longValue:
+        return "long-value";
+    }
+    return "";
+}
+
+// Arguments with about size bytes in total.
+std::vector<std::string> makeWorstCase(WorstCase shape, size_t size) {
+    std::mt19937 random(static_cast<unsigned>(size));
+    std::vector<std::string> args;
+    size_t bytes = 0;
+    auto push = [&](std::string arg) {
+        bytes += arg.size() + 1;
+        args.push_back(std::move(arg));
+    };
+    switch(shape) {
+    case WorstCase::unknown:
+        while(bytes < size) {
+            push("--unknown-" + std::to_string(random() % 1000));
+            push("value");
+            // Any upper case letter but L, which is the list.
+            char c = "ABCDEFGHIJKMNOPQRSTUVWXYZ"[random() % 25];
+            push("-" + std::string(8, c));
+        }
+        break;
+    case WorstCase::bigCluster: {
+        std::string arg = "-";
+        while(arg.size() < size)
+            arg += static_cast<char>('a' + random() % 26);
+        push(std::move(arg));
+        break;
+    }
+    case WorstCase::clusters:
+        while(bytes < size)
+            push("-abcdefghijklmnopqrstuvwxyz");
+        break;
+    case WorstCase::nearNames:
+        // Differ from registered names in the last character only.
+        while(bytes < size)
+            push("--option-" + std::to_string(random() % 1000) + "x=1");
+        break;
+    case WorstCase::listRun:
+        push("--list");
+        while(bytes < size)
+            push(std::to_string(random() % 100000));
+        break;
+    case WorstCase::longValue:
+        // Unknown and skipped, so only finding the '=' reads the value.
+        push("--data=" + std::string(size, 'x'));
+        break;
+    }
+    return args;
+}
+
+// Best of several timings of one parse, in seconds.
+double timeParse(CommandLineParser& parser, std::vector<std::string>& args) {
+    std::vector<char*> argv;
+    argv.push_back(const_cast<char*>("bench"));
+    for(auto& arg : args)
+        argv.push_back(arg.data());
+    int argc = static_cast<int>(argv.size());
+    double best = INFINITY;
+    for(int i = 0; i < 7; ++i) {
+        parser.reset();
+        auto start = std::chrono::steady_clock::now();
+        if(!parser.parse(argc, argv.data())) {
+            std::cerr << "parse failed: " << parser.error() << '\n';
+            std::exit(1);
+        }
+        best = std::min(
+            best, std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count());
+    }
+    return best;
+}
+
+// Fits time = c * size^k over growing sizes and fails if k exceeds
+// maxExponent.
+bool checkScaling(size_t maxBytes, double maxExponent) {
+    Schema schema(1000, false);
+    schema.parser.skipUnknown();
+    // Leaves the list values of the largest case in place, so the list run
+    // does not time its own growth from empty.
+    schema.list.reserve(maxBytes);
+    const WorstCase shapes[] = {
+        WorstCase::unknown, WorstCase::bigCluster, WorstCase::clusters,
+        WorstCase::nearNames, WorstCase::listRun, WorstCase::longValue};
+    bool ok = true;
+    std::cout << "# shape\tbytes\tns/byte\n";
+    for(auto shape : shapes) {
+        GrowthFit fit;
+        for(size_t size = 4096; size <= maxBytes; size *= 4) {
+            auto args = makeWorstCase(shape, size);
+            double seconds = timeParse(schema.parser, args);
+            std::cout << worstCaseName(shape) << '\t' << size << '\t'
+                      << seconds * 1e9 / size << '\n';
+            fit.add(static_cast<double>(size), seconds);
+        }
+        double exponent = fit.exponent();
+        bool linear = exponent <= maxExponent;
+        std::cout << worstCaseName(shape) << "\texponent\t" << exponent
+                  << (linear ? "\n" : "\tFAILED\n");
+        ok = ok && linear;
+    }
+    return ok;
+}
+
+// Value sets of the conversion benchmark: short and 64 bit ids and negative
+// ints. Floating point values are converted by std::from_chars itself.
+enum class Numbers { ids, wideIds, negatives };
+
+const char* numbersName(Numbers numbers) {
+    switch(numbers) {
+    case Numbers::ids:
+        return "uint32 ids";
+    case Numbers::wideIds:
+        return "uint64 ids";
+    case Numbers::negatives:
+        return "int64 negative";
+    }
+    return "";
+}
+
+std::vector<std::string> makeNumbers(Numbers numbers, size_t count) {
+    std::mt19937_64 random(count);
+    std::vector<std::string> texts;
+    for(size_t i = 0; i < count; ++i) {
+        switch(numbers) {
+        case Numbers::ids:
+            texts.push_back(std::to_string(random() % 1000000));
+            break;
+        case Numbers::wideIds:
+            texts.push_back(std::to_string(random() | (1ull << 60)));
+            break;
+        case Numbers::negatives:
+            texts.push_back(std::to_string(-int64_t(random() % 1000000000)));
+            break;
+        }
+    }
+    return texts;
+}
+
+// Nanoseconds per value of the fastest pass of convert over texts within
+// minSeconds. The texts fit in cache, so the passes time the conversion
+// itself.
+template<class T, class Convert>
+double nsPerValue(
+    const std::vector<std::string>& texts, std::vector<T>& values,
+    double minSeconds, Convert&& convert) {
+    double best = INFINITY;
+    double seconds = 0;
+    size_t iterations = 0;
+    auto begin = std::chrono::steady_clock::now();
+    do {
+        auto start = std::chrono::steady_clock::now();
+        for(size_t i = 0; i < texts.size(); ++i) {
+            if(!convert(texts[i], values[i])) {
+                std::cerr << "conversion failed: " << texts[i] << '\n';
+                std::exit(1);
+            }
+        }
+        auto now = std::chrono::steady_clock::now();
+        best = std::min(
+            best, std::chrono::duration<double>(now - start).count());
+        seconds = std::chrono::duration<double>(now - begin).count();
+        ++iterations;
+    } while(seconds < minSeconds || iterations < 3);
+    return best * 1e9 / texts.size();
+}
+
+template<class T>
+bool runNumbers(Numbers numbers, double minSeconds) {
+    auto texts = makeNumbers(numbers, 4096);
+    std::vector<T> kernelValues(texts.size());
+    std::vector<T> fromCharsValues(texts.size());
+    double kernelNs = nsPerValue(
+        texts, kernelValues, minSeconds,
+        [](std::string_view text, T& value) {
+            return detail::parse(text, value);
+        });
+    double fromCharsNs = nsPerValue(
+        texts, fromCharsValues, minSeconds,
+        [](std::string_view text, T& value) {
+            auto end = text.data() + text.size();
+            auto res = std::from_chars(text.data(), end, value);
+            return res.ec == std::errc{} && res.ptr == end;
+        });
+    bool same = kernelValues == fromCharsValues;
+    std::cout << numbersName(numbers) << '\t' << kernelNs << '\t'
+              << fromCharsNs << '\t' << fromCharsNs / kernelNs
+              << (same ? "\n" : "\tDIFFERENT\n");
+    return same;
+}
+
+// Times the integer kernels behind option values and lists against
+// plain std::from_chars, and fails if any value differs.
+bool runConversions(double minSeconds) {
+    std::cout << "# values\tparse ns/value\tfrom_chars ns/value"
+                 "\tfrom_chars/parse\n";
+    bool ok = runNumbers<uint32_t>(Numbers::ids, minSeconds);
+    ok = runNumbers<uint64_t>(Numbers::wideIds, minSeconds) && ok;
+    ok = runNumbers<int64_t>(Numbers::negatives, minSeconds) && ok;
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t maxTokens = 1000000;
+    size_t maxOptions = 10000;
+    double minMillis = 200;
+    bool help = false;
+    bool scaling = false;
+    bool conversions = false;
+    size_t maxBytes = 1 << 22;
+    double maxExponent = 1.2;
+    CommandLineParser options;
+    options.addFlag(help, "help,h", "print help")
+        .add(maxTokens, "max-tokens,t,n", "largest command line, in tokens")
+        .add(maxOptions, "max-options,o,n", "largest schema, in options")
+        .add(minMillis, "min-time,m,ms", "minimum run time of a case")
+        .addFlag(scaling, "check-scaling,s", "check worst cases are linear")
+        .add(maxBytes, "max-bytes,b,n", "largest worst case command line")
+        .add(maxExponent, "max-exponent,e,k", "largest accepted exponent")
+        .addFlag(
+            conversions, "conversions,c",
+            "compare integer conversions with std::from_chars");
+    if(!options.parse(argc, argv) || help) {
+        std::cerr << options.error() << '\n' << options.getHelp();
+        return help ? 0 : 1;
+    }
+    if(scaling)
+        return checkScaling(maxBytes, maxExponent) ? 0 : 1;
+    if(conversions)
+        return runConversions(minMillis / 1000) ? 0 : 1;
+    PerfCounters counters;
+    if(!counters.available())
+        std::cout << "# perf_event_open not available, no counters\n";
+    std::cout << "# options\ttokens\tshape\tns/arg\tallocs/parse"
+                 "\tcycles/arg\tinstr/arg\tbranch-misses/arg\n";
+    const Shape shapes[] = {
+        Shape::longNames, Shape::clusters, Shape::positional, Shape::lists};
+    for(size_t optionCount : {10, 100, 1000, 10000}) {
+        if(optionCount > maxOptions)
+            break;
+        Schema schema(optionCount, true);
+        Schema listSchema(optionCount, false);
+        for(auto shape : shapes) {
+            auto& target = shape == Shape::lists ? listSchema : schema;
+            for(size_t tokens = 10; tokens <= maxTokens; tokens *= 10) {
+                runCase(
+                    target, optionCount, shape, tokens, minMillis / 1000,
+                    counters);
+            }
+        }
+        runHelp(schema, optionCount, minMillis / 1000);
+    }
+    return 0;
+}
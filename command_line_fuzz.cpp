@@ -0,0 +1,296 @@
+// Fuzz target for the parser's input sources. The input is split on '\0'
+// into arguments and parsed by a strict parser, one skipping unknown options
+// and one with subcommands; the whole input is also parsed as a shell
+// command line. Written to a file, it is read as a config file and as a
+// response file, and its arguments with a prefix are parsed as environment
+// variables.
+//
+// Built with COMMAND_LINE_LIBFUZZER and -fsanitize=fuzzer it is a libFuzzer
+// target. Run it with -timeout=N and -report_slow_units=N to have the
+// coverage guided search report slow inputs. Otherwise main() runs a simple
+// mutation search for the input with the highest parse time per byte and
+// fails if repeating that input grows the parse time faster than linearly.
+// Files given on the command line are parsed once each, to replay inputs.
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string_view>
+#include <vector>
+
+#include "bench_util.hpp"
+#include "command_line_parser.hpp"
+
+namespace {
+
+using namespace univang;
+
+struct Targets {
+    std::array<bool, 4> flags{};
+    int number = 0;
+    double real = 0;
+    std::string_view text;
+    std::vector<int> list;
+    std::vector<std::string_view> files;
+    bool force = false;
+    std::vector<std::string_view> commandFiles;
+};
+
+struct Parsers {
+    Targets targets;
+    CommandLineParser strict;
+    CommandLineParser skipping;
+    CommandLineParser commands;
+    // Config file, response file and environment variables.
+    CommandLineParser files;
+    std::string path;
+    std::string include;
+    // Prepared input: arguments split on '\0' and environment entries.
+    std::string_view input;
+    std::vector<std::string_view> args;
+    std::vector<std::string> entries;
+    std::vector<char*> envp;
+
+    Parsers() {
+        for(auto* parser : {&strict, &skipping, &commands, &files}) {
+            parser->addFlag(targets.flags[0], "all,a")
+                .addFlag(targets.flags[1], "brief,b")
+                .addFlag(targets.flags[2], "color,c")
+                .addFlag(targets.flags[3], "verbose,v")
+                .add(targets.number, "number,n")
+                .add(targets.real, "real,r")
+                .add(targets.text, "text,t")
+                .add(targets.list, "list,L");
+        }
+        strict.add(targets.files, ",,file", "", -1);
+        skipping.add(targets.files, ",,file", "", -1).skipUnknown();
+        commands.addCommand("run", [this](CommandLineParser& run) {
+            run.addFlag(targets.force, "force,f")
+                .add(targets.commandFiles, ",,file", "", -1);
+        });
+        files.addFlag(targets.force, "run.force")
+            .add(targets.commandFiles, "run.file")
+            .add(targets.files, ",,file", "", -1)
+            .responseFiles()
+            .envPrefix("FUZZ_");
+        auto name =
+            "command_line_fuzz_" + std::to_string(std::random_device()());
+        path = (std::filesystem::temp_directory_path() / name).string();
+        include = '@' + path;
+    }
+    ~Parsers() {
+        std::error_code error;
+        std::filesystem::remove(path, error);
+    }
+
+    // Splits the input into arguments, writes it to the file and builds
+    // the environment entries, so that run() only parses.
+    void prepare(std::string_view data) {
+        input = data;
+        args.clear();
+        for(size_t pos = 0; pos <= input.size();) {
+            auto end = std::min(input.find('\0', pos), input.size());
+            args.push_back(input.substr(pos, end - pos));
+            pos = end + 1;
+        }
+        std::ofstream(path, std::ios::binary | std::ios::trunc)
+            .write(input.data(), static_cast<std::streamsize>(input.size()));
+        entries.clear();
+        for(auto arg : args)
+            entries.push_back("FUZZ_" + std::string(arg));
+        envp.clear();
+        for(auto& entry : entries)
+            envp.push_back(entry.data());
+        envp.push_back(nullptr);
+    }
+
+    // Parses the prepared input with every parser and input source.
+    void run() {
+        for(auto* parser : {&strict, &skipping, &commands}) {
+            parser->reset();
+            parser->parse(args);
+        }
+        strict.reset();
+        strict.parse(input);
+        files.reset();
+        files.parseFile(path);
+        files.reset();
+        std::string_view response[] = {include};
+        files.parse(response);
+        files.reset();
+        files.parseEnv(envp.data());
+    }
+};
+
+Parsers& parsers() {
+    static Parsers instance;
+    return instance;
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    parsers().prepare({reinterpret_cast<const char*>(data), size});
+    parsers().run();
+    return 0;
+}
+
+#ifndef COMMAND_LINE_LIBFUZZER
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <iterator>
+
+namespace {
+
+// Input repeated up to size bytes, so that short inputs are not scored by
+// the fixed cost of a parse.
+std::string tile(const std::string& input, size_t size) {
+    std::string result;
+    while(result.size() < size) {
+        result += input;
+        result += '\0';
+    }
+    return result;
+}
+
+// Best of several timings of the parses of input, in seconds. Writing the
+// file and building the arguments is done before and not timed.
+double timeInput(const std::string& input) {
+    parsers().prepare(input);
+    double best = INFINITY;
+    for(int i = 0; i < 3; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        parsers().run();
+        best = std::min(
+            best, std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count());
+    }
+    return best;
+}
+
+std::string mutate(std::string input, size_t maxSize, std::mt19937& random) {
+    static constexpr std::string_view alphabet =
+        "-=,@\\'\" \t\n\0abcnrtvfLx019.e[]#;_NTR"sv;
+    auto pick = [&](size_t size) {
+        return size ? random() % size : 0;
+    };
+    switch(random() % 4) {
+    case 0:
+        input.insert(
+            input.begin() + pick(input.size() + 1),
+            alphabet[pick(alphabet.size())]);
+        break;
+    case 1:
+        if(!input.empty())
+            input[pick(input.size())] = alphabet[pick(alphabet.size())];
+        break;
+    case 2:
+        if(!input.empty())
+            input.erase(pick(input.size()), 1 + pick(8));
+        break;
+    default: {
+        // Repeats a slice, which is how most blowups are reached.
+        auto pos = pick(input.size());
+        auto slice = input.substr(pos, 1 + pick(16));
+        input.insert(pos, slice);
+    }
+    }
+    if(input.size() > maxSize)
+        input.resize(maxSize);
+    return input;
+}
+
+// Fits time = c * size^k over growing repetitions of input, as
+// command_line_bench --check-scaling does.
+double growthExponent(const std::string& input, size_t maxBytes) {
+    GrowthFit fit;
+    for(size_t size = 4096; size <= maxBytes; size *= 4) {
+        auto tiled = tile(input, size);
+        fit.add(static_cast<double>(tiled.size()), timeInput(tiled));
+    }
+    return fit.exponent();
+}
+
+void printInput(std::string_view input) {
+    for(auto c : input) {
+        if(c == '\0')
+            std::cout << "\\0";
+        else if(c == '\n')
+            std::cout << "\\n";
+        else
+            std::cout << c;
+    }
+    std::cout << '\n';
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    double seconds = 10;
+    size_t maxSize = 256;
+    size_t tileSize = 4096;
+    size_t maxBytes = 1 << 20;
+    double maxExponent = 1.2;
+    unsigned seed = 1;
+    bool help = false;
+    std::vector<std::string_view> files;
+    CommandLineParser options;
+    options.addFlag(help, "help,h", "print help")
+        .add(seconds, "seconds,s,s", "time of the search")
+        .add(maxSize, "max-len,l,n", "largest input, in bytes")
+        .add(tileSize, "tile,t,n", "bytes an input is repeated to for timing")
+        .add(maxBytes, "max-bytes,b,n", "largest input of the scaling check")
+        .add(maxExponent, "max-exponent,e,k", "largest accepted exponent")
+        .add(seed, "seed,,n", "random seed")
+        .add(files, ",,file", "inputs to replay", -1);
+    if(!options.parse(argc, argv) || help) {
+        std::cerr << options.error() << '\n' << options.getHelp();
+        return help ? 0 : 1;
+    }
+    for(auto file : files) {
+        std::ifstream stream{std::string(file), std::ios::binary};
+        std::string input{std::istreambuf_iterator<char>(stream), {}};
+        std::cout << file << '\t' << timeInput(input) * 1e9 << " ns\n";
+    }
+    if(!files.empty())
+        return 0;
+    std::vector<std::string> corpus = {
+        "--number=5\0-abc\0file\0--list\0001\0002\0-L\0003"s,
+        "-vn\0007\0--text\0--\0--real=1e5\0-x\0--unknown=1"s,
+        "run\0-f\0a\0b\0--force\0c"s,
+        "--text 'a b' \"c\\\"d\"\\\n e -b @file # comment"s,
+        "number = 5\n[run]\nforce = true\nfile = [a, 'b',\n \"c\\t\"]\n"s,
+        "NUMBER=5\0TEXT=abc\0LIST=3\0VERBOSE=\0RUN_FORCE=false"s,
+    };
+    std::mt19937 random(seed);
+    std::string worst = corpus[0];
+    double worstScore = 0;
+    auto deadline = std::chrono::steady_clock::now()
+                    + std::chrono::duration<double>(seconds);
+    size_t runs = 0;
+    while(std::chrono::steady_clock::now() < deadline) {
+        auto& base = random() % 2 ? worst : corpus[random() % corpus.size()];
+        auto input = mutate(base, maxSize, random);
+        auto tiled = tile(input, tileSize);
+        double score = timeInput(tiled) / tiled.size();
+        ++runs;
+        if(score > worstScore) {
+            worstScore = score;
+            worst = std::move(input);
+        }
+    }
+    double exponent = growthExponent(worst, maxBytes);
+    std::cout << runs << " inputs, slowest " << worstScore * 1e9
+              << " ns/byte, exponent " << exponent << ":\n";
+    printInput(worst);
+    if(exponent > maxExponent) {
+        std::cout << "FAILED: parse time grows faster than linearly\n";
+        return 1;
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,334 @@
+// Side by side benchmark of CommandLineParser and getopt_long on the same
+// schemas and command lines. Throughput is reported in ns per argument for
+// large command lines, latency as the median and 99th percentile of single
+// parse() calls on short ones. Three modes are compared: parse only, with
+// values kept as text; parse with conversion of values to int; and the
+// error path, a command line ending in an unknown option.
+#include <getopt.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+#include "bench_util.hpp"
+#include "command_line_parser.hpp"
+
+namespace {
+
+using namespace univang;
+using Clock = std::chrono::steady_clock;
+
+enum class Mode { text, convert, error };
+
+const char* modeName(Mode mode) {
+    switch(mode) {
+    case Mode::text:
+        return "parse";
+    case Mode::convert:
+        return "parse+convert";
+    case Mode::error:
+        return "error";
+    }
+    return "";
+}
+
+bool toInt(const char* str, int& value) {
+    return detail::parse(std::string_view(str), value);
+}
+
+// Option values for both parsers. Value options are long only, flags 'a'
+// to 'z' have long names too, -L is a list and other arguments are files.
+struct Values {
+    std::vector<std::string_view> texts;
+    std::vector<int> ints;
+    std::array<bool, 26> flags{};
+    std::vector<std::string_view> listTexts;
+    std::vector<int> listInts;
+    std::vector<std::string_view> files;
+
+    explicit Values(size_t optionCount)
+        : texts(optionCount), ints(optionCount) {
+    }
+    void clear() {
+        flags.fill(false);
+        listTexts.clear();
+        listInts.clear();
+        files.clear();
+    }
+};
+
+struct Schema {
+    std::vector<std::string> names;
+    Values values;
+    CommandLineParser textParser;
+    CommandLineParser intParser;
+    std::vector<option> longOptions;
+    static constexpr int firstValue = 1000;
+
+    explicit Schema(size_t optionCount)
+        : names(optionCount), values(optionCount) {
+        for(int i = 0; i < 26; ++i) {
+            textParser.addFlag(values.flags[i], benchFlagSpecs[i]);
+            intParser.addFlag(values.flags[i], benchFlagSpecs[i]);
+            longOptions.push_back(
+                {benchFlagNames[i], no_argument, nullptr, 'a' + i});
+        }
+        for(size_t i = 0; i < optionCount; ++i) {
+            names[i] = "option-" + std::to_string(i);
+            textParser.add(values.texts[i], names[i]);
+            intParser.add(values.ints[i], names[i]);
+        }
+        textParser.add(values.listTexts, "list,L")
+            .add(values.files, ",,file", "", -1);
+        intParser.add(values.listInts, "list,L")
+            .add(values.files, ",,file", "", -1);
+        for(size_t i = 0; i < optionCount; ++i) {
+            longOptions.push_back(
+                {names[i].c_str(), required_argument, nullptr,
+                 firstValue + static_cast<int>(i)});
+        }
+        longOptions.push_back({"list", required_argument, nullptr, 'L'});
+        longOptions.push_back({nullptr, 0, nullptr, 0});
+    }
+
+    bool parse(Mode mode, int argc, char** argv) {
+        auto& parser = mode == Mode::convert ? intParser : textParser;
+        values.clear();
+        parser.reset();
+        return parser.parse(argc, argv);
+    }
+
+    // The same work with getopt_long: '-' returns file arguments in order
+    // as code 1 instead of permuting argv.
+    bool parseGetopt(Mode mode, int argc, char** argv) {
+        static const char shortOptions[] = "-abcdefghijklmnopqrstuvwxyzL:";
+        values.clear();
+        optind = 0;
+        opterr = 0;
+        bool convert = mode == Mode::convert;
+        int code;
+        while((code = getopt_long(
+                   argc, argv, shortOptions, longOptions.data(), nullptr))
+              != -1) {
+            if(code == 1)
+                values.files.push_back(optarg);
+            else if(code >= 'a' && code <= 'z')
+                values.flags[code - 'a'] = true;
+            else if(code == 'L') {
+                if(!convert)
+                    values.listTexts.push_back(optarg);
+                else if(!toInt(optarg, values.listInts.emplace_back()))
+                    return false;
+            }
+            else if(code >= firstValue) {
+                size_t index = code - firstValue;
+                if(!convert)
+                    values.texts[index] = optarg;
+                else if(!toInt(optarg, values.ints[index]))
+                    return false;
+            }
+            else
+                return false;
+        }
+        return true;
+    }
+};
+
+enum class Shape { longNames, clusters, positional, lists, mixed };
+
+const char* shapeName(Shape shape) {
+    switch(shape) {
+    case Shape::longNames:
+        return "long";
+    case Shape::clusters:
+        return "cluster";
+    case Shape::positional:
+        return "positional";
+    case Shape::lists:
+        return "list";
+    case Shape::mixed:
+        return "mixed";
+    }
+    return "";
+}
+
+struct Argv {
+    std::vector<std::string> args;
+    std::vector<char*> argv;
+
+    int argc() const {
+        return static_cast<int>(argv.size());
+    }
+    char** data() {
+        return argv.data();
+    }
+};
+
+Argv makeArgv(Shape shape, size_t optionCount, size_t tokenCount, Mode mode) {
+    std::mt19937 random(static_cast<unsigned>(tokenCount * 31 + optionCount));
+    Argv result;
+    auto& args = result.args;
+    auto longOption = [&] {
+        args.push_back(
+            "--option-" + std::to_string(random() % optionCount) + "="
+            + std::to_string(random() % 100000));
+    };
+    auto cluster = [&] {
+        std::string arg = "-";
+        for(size_t i = 0; i < 8; ++i)
+            arg += static_cast<char>('a' + random() % 26);
+        args.push_back(std::move(arg));
+    };
+    auto file = [&] {
+        args.push_back("file" + std::to_string(random() % 100000));
+    };
+    auto listValue = [&] {
+        args.push_back("-L");
+        args.push_back(std::to_string(random() % 100000));
+    };
+    while(args.size() < tokenCount) {
+        switch(shape) {
+        case Shape::longNames:
+            longOption();
+            break;
+        case Shape::clusters:
+            cluster();
+            break;
+        case Shape::positional:
+            file();
+            break;
+        case Shape::lists:
+            listValue();
+            break;
+        case Shape::mixed:
+            switch(random() % 4) {
+            case 0:
+                longOption();
+                break;
+            case 1:
+                cluster();
+                break;
+            case 2:
+                file();
+                break;
+            default:
+                listValue();
+            }
+        }
+    }
+    if(mode == Mode::error)
+        args.push_back("--no-such-option");
+    result.argv.push_back(const_cast<char*>("bench"));
+    for(auto& arg : args)
+        result.argv.push_back(arg.data());
+    return result;
+}
+
+template<class Parse>
+double nsPerArg(Argv& argv, double minSeconds, Parse&& parse) {
+    size_t iterations = 0;
+    double seconds = 0;
+    auto start = Clock::now();
+    do {
+        parse(argv.argc(), argv.data());
+        ++iterations;
+        seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    } while(seconds < minSeconds || iterations < 3);
+    return seconds * 1e9 / iterations / (argv.argc() - 1);
+}
+
+// Median and 99th percentile of single calls, in ns.
+template<class Parse>
+std::pair<double, double> latency(Argv& argv, size_t calls, Parse&& parse) {
+    std::vector<double> times(calls);
+    for(auto& time : times) {
+        auto start = Clock::now();
+        parse(argv.argc(), argv.data());
+        time = std::chrono::duration<double, std::nano>(Clock::now() - start)
+                   .count();
+    }
+    std::sort(times.begin(), times.end());
+    return {times[calls / 2], times[calls * 99 / 100]};
+}
+
+// Both parsers must accept the same command lines and see the same number of
+// list values and files, or the comparison is meaningless.
+void checkSame(Schema& schema, Mode mode, Argv& argv) {
+    auto& values = schema.values;
+    auto counts = [&] {
+        return std::pair(
+            values.files.size(),
+            values.listTexts.size() + values.listInts.size());
+    };
+    bool ok = schema.parse(mode, argv.argc(), argv.data());
+    auto parsed = counts();
+    bool getoptOk = schema.parseGetopt(mode, argv.argc(), argv.data());
+    if(ok != getoptOk || ok == (mode == Mode::error)
+       || (ok && parsed != counts())) {
+        std::cerr << "parsers disagree on " << modeName(mode) << ": "
+                  << schema.textParser.error() << '\n';
+        std::exit(1);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t tokens = 10000;
+    size_t latencyTokens = 10;
+    size_t maxOptions = 10000;
+    double minMillis = 200;
+    bool help = false;
+    CommandLineParser options;
+    options.addFlag(help, "help,h", "print help")
+        .add(tokens, "tokens,t,n", "command line size for throughput")
+        .add(latencyTokens, "latency-tokens,l,n", "command line for latency")
+        .add(maxOptions, "max-options,o,n", "largest schema, in options")
+        .add(minMillis, "min-time,m,ms", "minimum run time of a case");
+    if(!options.parse(argc, argv) || help) {
+        std::cerr << options.error() << '\n' << options.getHelp();
+        return help ? 0 : 1;
+    }
+    std::cout << "# options\tshape\tmode\tclp ns/arg\tgetopt ns/arg"
+                 "\tgetopt/clp\tclp p50 ns\tclp p99 ns\tgetopt p50 ns"
+                 "\tgetopt p99 ns\n";
+    const Shape shapes[] = {
+        Shape::longNames, Shape::clusters, Shape::positional, Shape::lists,
+        Shape::mixed};
+    const Mode modes[] = {Mode::text, Mode::convert, Mode::error};
+    double minSeconds = minMillis / 1000;
+    for(size_t optionCount : {10, 100, 1000, 10000}) {
+        if(optionCount > maxOptions)
+            break;
+        Schema schema(optionCount);
+        auto clp = [&](Mode mode) {
+            return [&schema, mode](int argc, char** argv) {
+                return schema.parse(mode, argc, argv);
+            };
+        };
+        auto getopt = [&](Mode mode) {
+            return [&schema, mode](int argc, char** argv) {
+                return schema.parseGetopt(mode, argc, argv);
+            };
+        };
+        for(auto shape : shapes) {
+            for(auto mode : modes) {
+                auto big = makeArgv(shape, optionCount, tokens, mode);
+                auto small = makeArgv(shape, optionCount, latencyTokens, mode);
+                checkSame(schema, mode, big);
+                double clpNs = nsPerArg(big, minSeconds, clp(mode));
+                double getoptNs = nsPerArg(big, minSeconds, getopt(mode));
+                auto clpLatency = latency(small, 10000, clp(mode));
+                auto getoptLatency = latency(small, 10000, getopt(mode));
+                std::cout << optionCount << '\t' << shapeName(shape) << '\t'
+                          << modeName(mode) << '\t' << clpNs << '\t'
+                          << getoptNs << '\t' << getoptNs / clpNs << '\t'
+                          << clpLatency.first << '\t' << clpLatency.second
+                          << '\t' << getoptLatency.first << '\t'
+                          << getoptLatency.second << '\n';
+            }
+        }
+    }
+    return 0;
+}
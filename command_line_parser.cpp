@@ -0,0 +1,4 @@
+// Non-template functions of command_line_parser.hpp, compiled once for the
+// command_line_parser library. Its users define COMMAND_LINE_PARSER_LIB.
+#define COMMAND_LINE_PARSER_SOURCE
+#include "command_line_parser.hpp"
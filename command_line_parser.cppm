@@ -0,0 +1,23 @@
+// C++20 module interface of command_line_parser.hpp:
+//   import univang.command_line_parser;
+// Built against the command_line_parser library, so importers get the
+// declarations and templates and link the rest.
+module;
+#include "command_line_parser.hpp"
+export module univang.command_line_parser;
+
+export namespace univang {
+
+using univang::CommandLineParser;
+using univang::CommandLineSchema;
+using univang::OptionSpec;
+using univang::ParseError;
+using univang::ParseErrorInfo;
+using univang::ParseState;
+using univang::uniqueSpecs;
+
+inline namespace literals {
+using univang::literals::operator""_spec;
+} // namespace literals
+
+} // namespace univang
@@ -1,90 +1,1083 @@
 #pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
 #include <optional>
+#include <span>
 #include <string>
+#include <utility>
 #include <vector>
 
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+// The non-template functions are inline by default. With
+// COMMAND_LINE_PARSER_LIB they are only declared and linked from the
+// command_line_parser library, which compiles them once in
+// command_line_parser.cpp with COMMAND_LINE_PARSER_SOURCE.
+#if defined(COMMAND_LINE_PARSER_LIB) || defined(COMMAND_LINE_PARSER_SOURCE)
+#define COMMAND_LINE_PARSER_INLINE
+#else
+#define COMMAND_LINE_PARSER_INLINE inline
+#endif
+#if !defined(COMMAND_LINE_PARSER_LIB) || defined(COMMAND_LINE_PARSER_SOURCE)
+#define COMMAND_LINE_PARSER_DEFINITIONS
+#endif
+
 using namespace std::literals;
 
 namespace univang {
 
-class CommandLineParser {
-    using ParseFn = bool (*)(void*, std::string_view);
-    enum class OptionType : uint8_t { param, flag, list };
+// Option specification "[+]name[,flags[,hint]]": leading '+' marks a required
+// option, flags is a set of single character aliases, hint names the value
+// in help output. The explicit constructor parses and validates the spec at
+// compile time, so tables of specs can be constexpr or constinit:
+//   constexpr OptionSpec specs[] = {"help,h"_spec, "+level,l,n"_spec};
+//   static_assert(uniqueSpecs(specs));
+struct OptionSpec {
+    std::string_view name;
+    std::string_view flags;
+    std::string_view hint;
+    bool required = false;
+
+    constexpr OptionSpec() = default;
+    consteval explicit OptionSpec(std::string_view spec) {
+        if(auto* reason = check(spec))
+            throw reason;
+        *this = split(spec);
+    }
+
+    // Splits a spec without validation, same as for runtime spec strings.
+    static constexpr OptionSpec split(std::string_view spec) {
+        OptionSpec result;
+        result.required = !spec.empty() && spec[0] == '+';
+        if(result.required)
+            spec.remove_prefix(1);
+        result.name = spec;
+        auto pos = spec.find(',');
+        if(pos == std::string_view::npos)
+            return result;
+        result.name = spec.substr(0, pos);
+        spec.remove_prefix(pos + 1);
+        result.flags = spec;
+        pos = spec.find(',');
+        if(pos == std::string_view::npos)
+            return result;
+        result.flags = spec.substr(0, pos);
+        result.hint = spec.substr(pos + 1);
+        return result;
+    }
+    // Returns the reason a spec is malformed or nullptr if it is valid.
+    static constexpr const char* check(std::string_view spec) {
+        auto parts = split(spec);
+        if(parts.required)
+            spec.remove_prefix(1);
+        size_t fields = 1;
+        for(auto c : spec) {
+            if(c == ',')
+                ++fields;
+            else if(c <= ' ' || c == 0x7f)
+                return "spaces and control characters not allowed";
+        }
+        if(fields > 3)
+            return "too many fields";
+        if(fields > 1 && spec.back() == ',')
+            return "empty trailing field";
+        if(!parts.name.empty()) {
+            if(parts.name[0] == '-' || parts.name[0] == '+')
+                return "option name starts with '-' or '+'";
+            if(parts.name.find('=') != std::string_view::npos)
+                return "option name contains '='";
+        }
+        for(size_t i = 0; i < parts.flags.size(); ++i) {
+            auto c = parts.flags[i];
+            if(c == '-' || c == '+' || c == '=')
+                return "invalid flag character";
+            if(parts.flags.find(c, i + 1) != std::string_view::npos)
+                return "duplicate flag";
+        }
+        return nullptr;
+    }
+};
+
+// Checks that no two specs share a long name or a flag character.
+template<size_t N>
+consteval bool uniqueSpecs(const OptionSpec (&specs)[N]) {
+    for(size_t i = 0; i < N; ++i) {
+        for(size_t j = i + 1; j < N; ++j) {
+            if(!specs[i].name.empty() && specs[i].name == specs[j].name)
+                throw "duplicate option name";
+            for(auto c : specs[i].flags) {
+                if(specs[j].flags.find(c) != std::string_view::npos)
+                    throw "duplicate flag";
+            }
+        }
+    }
+    return true;
+}
+
+inline namespace literals {
+consteval OptionSpec operator""_spec(const char* spec, size_t size) {
+    return OptionSpec(std::string_view(spec, size));
+}
+} // namespace literals
+
+enum class ParseError : uint8_t {
+    none,
+    unknownOption,            // arg is the long option name
+    unknownFlag,              // arg is the short flag character
+    invalidValue,
+    positionalNotAllowed,
+    missingName,
+    flagValueMix,
+    valueUnexpected,
+    valueRequired,
+    requiredMissing,
+    responseFileUnreadable,   // arg is the file path
+    responseFileNesting,      // arg is the file path
+    unterminatedQuote,        // arg is the file path
+    configFileUnreadable,     // arg is the file path
+    configFileSyntax,         // arg is the file path, argIndex the line
+    invalidEnvValue,          // arg is the NAME=value entry
+    unterminatedCommandQuote, // arg is the command line from the word
+    unknownCommand,
+};
+
+// Error of the last parse() or checkRequired() call. Failing costs a few
+// stores and a copy of the argument, the message text is only built when
+// error() is called.
+struct ParseErrorInfo {
+    ParseError code = ParseError::none;
+    // Index in argv of the argument that failed, 0 if none. With response
+    // files expanded it is the index in the expanded argument list, except
+    // for response file errors that refer to the @file argument in argv.
+    // For parseFile() errors it is the line number.
+    int argIndex = 0;
+    // Index of the option in registration order, -1 if none. Errors of a
+    // subcommand refer to the options of that command.
+    int option = -1;
+    // Text the message refers to: argument, value, option name or flag. It
+    // is a copy kept by the parser, cut to 256 bytes, and valid until the
+    // next parse, so the parsed input may be a temporary.
+    std::string_view arg;
+};
+
+namespace detail {
+
+// String template argument, defined in static_command_line_parser.hpp.
+template<size_t N>
+struct FixedString;
+
+enum class OptionType : uint8_t { param, flag, list };
+
+// Option description used by help output and the parse loop.
+struct OptionInfo {
+    OptionType type = OptionType::param;
+    bool required = false;
+    std::string_view name;
+    std::string_view flags;
+    std::string_view help;
+    std::string_view hint;
+    int position = 0;
+};
+
+// FNV-1a, the seed selects one of a family of hash functions.
+constexpr uint64_t hashName(std::string_view name, uint64_t seed = 0) {
+    uint64_t hash = 0xcbf29ce484222325ull ^ seed;
+    for(auto c : name) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// Environment variable spelling of a long name character: upper case, '-'
+// and '.' become '_'.
+constexpr char envChar(char c) {
+    if(c >= 'a' && c <= 'z')
+        return static_cast<char>(c - 'a' + 'A');
+    return c == '-' || c == '.' ? '_' : c;
+}
+// Same as hashName() of the environment variable spelling of name.
+constexpr uint64_t hashEnvName(std::string_view name) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for(auto c : name) {
+        hash ^= static_cast<unsigned char>(envChar(c));
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// Bit per byte value, tests a whole run of short flags in one pass.
+struct CharMask {
+    std::array<uint64_t, 4> bits{};
+
+    constexpr void set(char c) {
+        auto byte = static_cast<unsigned char>(c);
+        bits[byte >> 6] |= uint64_t(1) << (byte & 63);
+    }
+    constexpr bool test(char c) const {
+        auto byte = static_cast<unsigned char>(c);
+        return bits[byte >> 6] & (uint64_t(1) << (byte & 63));
+    }
+    constexpr bool all(std::string_view chars) const {
+        for(auto c : chars) {
+            if(!test(c))
+                return false;
+        }
+        return true;
+    }
+};
+
+// Conversion kernels shared by all value types of a category, so a new
+// value type adds no conversion code. size is the size of the value, values
+// out of its range are rejected as std::from_chars does.
+COMMAND_LINE_PARSER_INLINE bool parseSigned(
+    void* value, std::string_view str, size_t size);
+COMMAND_LINE_PARSER_INLINE bool parseUnsigned(
+    void* value, std::string_view str, size_t size);
+COMMAND_LINE_PARSER_INLINE bool parseFloating(
+    void* value, std::string_view str, size_t size);
+inline bool parseStringView(void* value, std::string_view str, size_t) {
+    *static_cast<std::string_view*>(value) = str;
+    return true;
+}
+inline bool parseString(void* value, std::string_view str, size_t) {
+    *static_cast<std::string*>(value) = str;
+    return true;
+}
+// Flags on the command line have no value, config files and environment
+// variables spell it out.
+inline bool parseFlag(void* value, std::string_view str, size_t = 1) {
+    if(str.empty() || str == "true"sv || str == "1"sv)
+        *static_cast<bool*>(value) = true;
+    else if(str == "false"sv || str == "0"sv)
+        *static_cast<bool*>(value) = false;
+    else
+        return false;
+    return true;
+}
+
+inline bool parse(std::string_view str, std::string_view& value) {
+    return parseStringView(&value, str, sizeof(value));
+}
+inline bool parse(std::string_view str, std::string& value) {
+    return parseString(&value, str, sizeof(value));
+}
+template<class T>
+std::enable_if_t<std::is_arithmetic_v<T>, bool> parse(
+    std::string_view str, T& value) {
+    if constexpr(std::is_same_v<T, bool>)
+        return parseFlag(&value, str);
+    else if constexpr(std::is_floating_point_v<T>)
+        return parseFloating(&value, str, sizeof(T));
+    else if constexpr(sizeof(T) > sizeof(long long)) {
+        auto res = std::from_chars(str.data(), str.data() + str.size(), value);
+        return res.ec == std::errc{} && res.ptr == str.data() + str.size();
+    }
+    else if constexpr(std::is_signed_v<T>)
+        return parseSigned(&value, str, sizeof(T));
+    else
+        return parseUnsigned(&value, str, sizeof(T));
+}
+template<class T>
+bool parse(std::string_view str, std::optional<T>& value) {
+    T item{};
+    if(!parse(str, item))
+        return false;
+    value = std::move(item);
+    return true;
+}
+
+// Text in a fixed buffer provided by the caller. The buffer is never
+// reallocated, text that does not fit is cut off and the content stays zero
+// terminated.
+class FixedText {
+public:
+    FixedText(char* data, size_t size)
+        : data_(size ? data : nullptr), capacity_(size ? size - 1 : 0) {
+        if(data_)
+            data_[0] = 0;
+    }
+    size_t size() const {
+        return size_;
+    }
+    FixedText& operator+=(std::string_view text) {
+        size_t count = std::min(text.size(), capacity_ - size_);
+        std::copy_n(text.data(), count, data_ + size_);
+        size_ += count;
+        if(data_)
+            data_[size_] = 0;
+        return *this;
+    }
+    FixedText& operator+=(char c) {
+        return *this += std::string_view(&c, 1);
+    }
+
+private:
+    char* data_;
+    size_t capacity_;
+    size_t size_ = 0;
+};
+
+template<class Text>
+size_t formatOptName(const OptionInfo& opt, Text& result);
+
+template<class Text>
+void formatError(
+    const ParseErrorInfo& info, const OptionInfo* option, Text& text) {
+    switch(info.code) {
+    case ParseError::none:
+        return;
+    case ParseError::unknownOption:
+        text += "unknown option: --"sv;
+        break;
+    case ParseError::unknownFlag:
+        text += "unknown option: -"sv;
+        break;
+    case ParseError::invalidValue:
+        text += "invalid option value: "sv;
+        break;
+    case ParseError::positionalNotAllowed:
+        text += "positional arg not allowed: "sv;
+        break;
+    case ParseError::missingName:
+        text += "missing option name: "sv;
+        break;
+    case ParseError::flagValueMix:
+        text += "flag/argument mix disallowed: "sv;
+        break;
+    case ParseError::valueUnexpected:
+        text += "option value unexpected: "sv;
+        break;
+    case ParseError::valueRequired:
+        text += "option requires value: "sv;
+        break;
+    case ParseError::requiredMissing:
+        text += "required option missing: "sv;
+        formatOptName(*option, text);
+        return;
+    case ParseError::responseFileUnreadable:
+        text += "cannot read response file: "sv;
+        break;
+    case ParseError::responseFileNesting:
+        text += "response files nested too deep: "sv;
+        break;
+    case ParseError::unterminatedQuote:
+        text += "unterminated quote in response file: "sv;
+        break;
+    case ParseError::unterminatedCommandQuote:
+        text += "unterminated quote in command line: "sv;
+        break;
+    case ParseError::unknownCommand:
+        text += "unknown command: "sv;
+        break;
+    case ParseError::invalidEnvValue:
+        text += "invalid environment variable value: "sv;
+        break;
+    case ParseError::configFileUnreadable:
+        text += "cannot read config file: "sv;
+        break;
+    case ParseError::configFileSyntax: {
+        char line[16];
+        auto res = std::to_chars(line, line + sizeof(line), info.argIndex);
+        text += "invalid config file syntax: "sv;
+        text += info.arg;
+        text += ':';
+        text += std::string_view(line, res.ptr - line);
+        return;
+    }
+    }
+    text += info.arg;
+}
+
+// Keeps the last error as a code, the message is formatted on request. The
+// text the error refers to and the option description are copied into the
+// state, so the error stays valid after the parsed arguments are gone
+// without allocating.
+class ErrorState {
+public:
+    // Longer text is cut to its first maxArgSize bytes.
+    static constexpr size_t maxArgSize = 256;
+
+    ErrorState() = default;
+    ErrorState(const ErrorState& other) {
+        *this = other;
+    }
+    ErrorState& operator=(const ErrorState& other) {
+        if(this == &other)
+            return *this;
+        info_ = other.info_;
+        info_.arg = copyArg(other.info_.arg);
+        option_ = other.option_;
+        message_ = other.message_;
+        formatted_ = other.formatted_;
+        return *this;
+    }
+
+    const ParseErrorInfo& info() const {
+        return info_;
+    }
+    void set(ParseError code, int argIndex, std::string_view arg) {
+        info_ = {code, argIndex, -1, copyArg(arg)};
+        formatted_ = false;
+    }
+    void set(
+        ParseError code, int argIndex, std::string_view arg,
+        const OptionInfo& option, size_t optionIndex) {
+        info_ = {
+            code, argIndex, static_cast<int>(optionIndex), copyArg(arg)};
+        option_ = option;
+        formatted_ = false;
+    }
+    void clear() {
+        set(ParseError::none, 0, {});
+    }
+    // Makes the argument index of a nested parse relative to the outer one.
+    void offsetArgIndex(int offset) {
+        if(info_.argIndex)
+            info_.argIndex += offset;
+    }
+    const std::string& message() const {
+        if(!formatted_) {
+            message_.clear();
+            formatError(info_, &option_, message_);
+            formatted_ = true;
+        }
+        return message_;
+    }
+    size_t format(char* data, size_t size) const {
+        FixedText text(data, size);
+        formatError(info_, &option_, text);
+        return text.size();
+    }
+
+private:
+    std::string_view copyArg(std::string_view arg) {
+        auto size = std::min(arg.size(), maxArgSize);
+        std::copy_n(arg.data(), size, arg_);
+        return std::string_view(arg_, size);
+    }
+
+private:
+    ParseErrorInfo info_;
+    // Only used by errors that refer to an option.
+    OptionInfo option_;
+    char arg_[maxArgSize];
+    mutable std::string message_;
+    mutable bool formatted_ = true;
+};
+
+// File contents mapped copy-on-write: the text can be edited in place
+// without changing the file, only the pages written to are copied.
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(MappedFile&& other) noexcept
+        : data_(std::exchange(other.data_, nullptr))
+        , size_(std::exchange(other.size_, 0)) {
+    }
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        return *this;
+    }
+    ~MappedFile() {
+        close();
+    }
+
+    bool open(const char* path);
+    void close();
+    char* data() const {
+        return data_;
+    }
+    size_t size() const {
+        return size_;
+    }
+
+private:
+    char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Splits text into words the way a POSIX shell does, without expansions.
+// Words are separated by whitespace, '#' at the start of a word comments out
+// the rest of the line. Single quotes keep the text as is, a backslash
+// escapes the next character outside of quotes and '$', '`', '"', '\\' or
+// a newline inside double quotes, backslash-newline joins lines. Words
+// without quotes and escapes are views of the text, others are unescaped
+// either over their own text or into a scratch buffer.
+class ShellReader {
+public:
+    // Unescapes words in place, so a copy-on-write mapping only copies the
+    // pages that have quotes or escapes.
+    ShellReader(char* text, size_t size)
+        : pos_(text), end_(text + size), text_(text), writable_(text) {
+    }
+    // Unescapes words into scratch, which must hold size characters and
+    // stays in use as long as the words do.
+    ShellReader(const char* text, size_t size, char* scratch)
+        : pos_(text), end_(text + size), text_(text), scratch_(scratch) {
+    }
+    // Reads the next word, returns false at the end of the text or on an
+    // unterminated quote.
+    bool next(std::string_view& word);
+    // Whether the last word started with an unquoted '@'.
+    bool isInclude() const {
+        return include_;
+    }
+    bool failed() const {
+        return failed_;
+    }
+    // Text from the start of the last word, the unterminated one on error.
+    std::string_view rest() const {
+        return std::string_view(begin_, end_ - begin_);
+    }
+
+private:
+    const char* pos_;
+    const char* end_;
+    const char* begin_ = nullptr;
+    const char* text_;
+    char* writable_ = nullptr;
+    char* scratch_ = nullptr;
+    bool include_ = false;
+    bool failed_ = false;
+};
+
+// Reads "key = value" entries of an INI/TOML-lite file in place, one pass
+// over the text. "[section]" lines prefix the following keys, '#' and ';'
+// start comment lines, '#' after whitespace ends a bare value. Values are
+// bare text up to the end of the line, "double quoted" with backslash
+// escapes, 'single quoted' as is, or arrays "[a, 'b', "c"]" that may span
+// lines and give one entry per element. Bare and single quoted values point
+// into the text, double quoted ones are unescaped over their own text.
+class ConfigReader {
+public:
+    ConfigReader(char* text, size_t size) : pos_(text), end_(text + size) {
+    }
+    // Reads the next entry, returns false at the end of the text or on a
+    // syntax error.
+    bool next(std::string_view& key, std::string_view& value);
+    // Section of the last entry, empty before the first section line.
+    std::string_view section() const {
+        return section_;
+    }
+    // Line of the last entry or of the syntax error.
+    int line() const {
+        return line_;
+    }
+    bool failed() const {
+        return failed_;
+    }
+
+private:
+    bool fail() {
+        failed_ = true;
+        return false;
+    }
+    void skipBlanks();
+    void skipLine();
+    bool endOfLine();
+    bool readValue(std::string_view& value);
+
+private:
+    char* pos_;
+    char* end_;
+    std::string_view section_;
+    std::string_view key_;
+    int line_ = 1;
+    bool inArray_ = false;
+    bool afterElement_ = false;
+    bool failed_ = false;
+};
+
+// Argument types that refer to text owned elsewhere.
+template<class T>
+concept ArgView = std::same_as<T, std::string_view>
+                  || std::same_as<T, const char*> || std::same_as<T, char*>;
+
+template<class R>
+using ArgReference = std::iter_reference_t<std::ranges::iterator_t<R&>>;
+
+// Forward range of arguments convertible to std::string_view, such as
+// std::vector<std::string> or std::span<const std::string_view>. A single
+// string is not a range of arguments. Option values point into the
+// arguments, so they must outlive the parse: a range yielding elements by
+// value must yield views, and a temporary range of strings must be a view,
+// not a container such as std::vector<std::string>{...}.
+template<class R>
+concept ArgRange =
+    std::forward_iterator<std::ranges::iterator_t<R&>>
+    && std::convertible_to<ArgReference<R>, std::string_view>
+    && !std::convertible_to<R, std::string_view>
+    && (std::is_lvalue_reference_v<ArgReference<R>>
+        || ArgView<std::remove_cv_t<ArgReference<R>>>)
+    && (std::ranges::borrowed_range<R>
+        || std::ranges::view<std::remove_cvref_t<R>>
+        || ArgView<std::remove_cvref_t<ArgReference<R>>>);
+
+// argv[0] without the directory.
+constexpr std::string_view programName(std::string_view path) {
+    size_t pathSepPos = path.find_last_of("/\\"sv);
+    if(pathSepPos != std::string_view::npos)
+        path.remove_prefix(pathSepPos + 1);
+    return path;
+}
+
+// Kind of a command line argument, told by its leading dashes.
+enum class ArgKind : uint8_t {
+    empty,      // "", skipped
+    dashes,     // "-" or "--", ends a pending option value
+    positional, // option value or positional argument
+    shortName,  // "-x" or "-x=value"
+    cluster,    // "-xyz", flags only
+    longName,   // "--name" or "--name=value"
+};
+
+// Argument split for the parse loop: the name without dashes and the value
+// after the first '=', or the whole argument if positional.
+struct ArgToken {
+    ArgKind kind = ArgKind::empty;
+    bool hasValue = false;
+    std::string_view name;
+    std::string_view value;
+};
+
+// Classifies arg by its first two bytes and splits an option at the first
+// '='. The search is std::string_view::find, which ends in memchr: glibc
+// picks its SSE2, AVX2 or EVEX version at load time, and a long
+// "--data=..." value is not read past the block holding the '='.
+constexpr ArgToken classifyArg(std::string_view arg) {
+    ArgToken token;
+    if(arg.empty())
+        return token;
+    if(arg[0] != '-') {
+        token.kind = ArgKind::positional;
+        token.value = arg;
+        return token;
+    }
+    bool isName = arg.size() > 1 && arg[1] == '-';
+    arg.remove_prefix(isName ? 2 : 1);
+    token.kind = ArgKind::dashes;
+    if(arg.empty())
+        return token;
+    token.name = arg;
+    auto eqPos = arg.find('=');
+    if(eqPos != std::string_view::npos) {
+        token.hasValue = true;
+        token.name = arg.substr(0, eqPos);
+        token.value = arg.substr(eqPos + 1);
+    }
+    if(isName)
+        token.kind = ArgKind::longName;
+    else if(token.name.size() == 1)
+        token.kind = ArgKind::shortName;
+    else
+        token.kind = ArgKind::cluster;
+    return token;
+}
+
+template<class Options>
+std::string formatHelp(std::string_view program, const Options& options);
+// Parses the arguments that follow the program name.
+template<class Parser, class Args>
+bool parseArgs(Parser& parser, ErrorState& error, Args&& args);
+template<class Parser>
+bool parseArgv(Parser& parser, ErrorState& error, int argc, char** argv);
+
+// Parses str into value, size is the size of the converted item.
+using ParseFn = bool (*)(void* value, std::string_view str, size_t size);
+using ResetFn = void (*)(void*);
+
+template<class T>
+bool parseValue(void* value, std::string_view str, size_t) {
+    return parse(str, *static_cast<T*>(value));
+}
+// Kernel of the category of T, types without one get their own parseValue.
+template<class T>
+constexpr ParseFn valueParser() {
+    if constexpr(std::is_same_v<T, bool>)
+        return &parseFlag;
+    else if constexpr(std::is_floating_point_v<T>)
+        return &parseFloating;
+    else if constexpr(
+        std::is_integral_v<T> && sizeof(T) <= sizeof(long long))
+        return std::is_signed_v<T> ? &parseSigned : &parseUnsigned;
+    else if constexpr(std::is_same_v<T, std::string_view>)
+        return &parseStringView;
+    else if constexpr(std::is_same_v<T, std::string>)
+        return &parseString;
+    else
+        return &parseValue<T>;
+}
+// Wrappers only move the converted item into place.
+template<class T>
+bool parseOptional(void* value, std::string_view str, size_t) {
+    T item{};
+    if(!valueParser<T>()(&item, str, sizeof(T)))
+        return false;
+    *static_cast<std::optional<T>*>(value) = std::move(item);
+    return true;
+}
+template<class T, class Alloc>
+bool parseList(void* value, std::string_view str, size_t) {
+    T item{};
+    if(!valueParser<T>()(&item, str, sizeof(T)))
+        return false;
+    static_cast<std::vector<T, Alloc>*>(value)->push_back(std::move(item));
+    return true;
+}
+inline void resetFlag(void* value) {
+    *static_cast<bool*>(value) = false;
+}
+template<class T, class Alloc>
+void resetList(void* value) {
+    static_cast<std::vector<T, Alloc>*>(value)->clear();
+}
+
+template<class M>
+struct MemberTraits;
+template<class C, class T>
+struct MemberTraits<T C::*> {
+    using Class = C;
+    using Type = T;
+};
+
+template<auto Member, ParseFn Parse>
+bool parseMember(void* target, std::string_view str, size_t size) {
+    using Class = typename MemberTraits<decltype(Member)>::Class;
+    return Parse(&(static_cast<Class*>(target)->*Member), str, size);
+}
+template<auto Member, ResetFn Reset>
+void resetMember(void* target) {
+    using Class = typename MemberTraits<decltype(Member)>::Class;
+    Reset(&(static_cast<Class*>(target)->*Member));
+}
+
+template<class T>
+struct ValueTraits {
+    static constexpr bool isList = false;
+    static constexpr ParseFn parse = valueParser<T>();
+    static constexpr ResetFn reset = nullptr;
+    static constexpr size_t size = sizeof(T);
+};
+template<class T>
+struct ValueTraits<std::optional<T>> {
+    static constexpr bool isList = false;
+    static constexpr ParseFn parse = &parseOptional<T>;
+    static constexpr ResetFn reset = nullptr;
+    static constexpr size_t size = sizeof(T);
+};
+template<class T, class Alloc>
+struct ValueTraits<std::vector<T, Alloc>> {
+    static constexpr bool isList = true;
+    static constexpr ParseFn parse = &parseList<T, Alloc>;
+    static constexpr ResetFn reset = &resetList<T, Alloc>;
+    static constexpr size_t size = sizeof(T);
+};
+
+// Prefix tree of names, one node per character, children chained as
+// siblings. A lookup walks the characters of the name without hashing or
+// comparing whole strings.
+class NameTrie {
+public:
+    // Adds a name, the first value added for a name is kept.
+    void insert(std::string_view name, uint32_t value);
+    // Value of the name + 1, 0 if it was not added.
+    uint32_t find(std::string_view name) const;
+
+private:
+    uint32_t child(uint32_t node, char c) const;
+
+private:
+    struct Node {
+        uint32_t child = 0;
+        uint32_t sibling = 0;
+        // Value + 1, 0 if no name ends here.
+        uint32_t value = 0;
+        char c = 0;
+    };
+    // Node 0 is the root, 0 as a link means none.
+    std::vector<Node> nodes_ = std::vector<Node>(1);
+};
+
+// Rest of an argument range after a subcommand name.
+template<class It, class End>
+struct ArgSlice {
+    It first;
+    End last;
+
+    It begin() const {
+        return first;
+    }
+    End end() const {
+        return last;
+    }
+};
+
+// Registered options with lookup tables for long names, short flags and
+// positions. What parsing reads is kept apart from names, help and hints,
+// which only name lookups, help and error messages need, so a parse over a
+// large table touches few cache lines. Lookups do not modify the table, so
+// once all options are added it can be shared between threads.
+class OptionTable {
+public:
+    // Fields read while parsing, 32 bytes on 64-bit targets: a name lookup
+    // compares the name and parses the value from one cache line. The
+    // OptionInfo with the same index has the rest.
     struct Option {
+        const char* nameData;
+        uint32_t nameSize;
+        // Passed to parse, lets one kernel convert values of any size.
+        uint16_t size;
         OptionType type;
-        bool parsed = false;
-        bool required = false;
         void* value;
         ParseFn parse;
-        std::string_view name;
-        std::string_view flags;
-        std::string_view help;
-        std::string_view hint;
-        int position;
-        Option(
-            OptionType type, void* value, ParseFn parse, std::string_view spec,
-            std::string_view help = {}, int position = 0);
+
+        std::string_view name() const {
+            return {nameData, nameSize};
+        }
     };
 
-    static bool parse(std::string_view str, std::string_view& value) {
-        value = str;
-        return true;
+    void add(
+        OptionType type, void* value, ParseFn parse, ResetFn reset,
+        size_t size, const OptionSpec& spec, std::string_view help = {},
+        int position = 0);
+    const std::vector<Option>& options() const {
+        return options_;
     }
-    static bool parse(std::string_view str, std::string& value) {
-        value = str;
-        return true;
+    const std::vector<OptionInfo>& infos() const {
+        return infos_;
     }
-    template<class T>
-    static std::enable_if_t<std::is_arithmetic_v<T>, bool> parse(
-        std::string_view str, T& value) {
-        auto res = std::from_chars(str.data(), str.data() + str.size(), value);
-        return res.ec == std::errc{} && res.ptr == str.data() + str.size();
+    // Options with a reset function, flags and lists. Only reset() walks
+    // them, so its cost does not grow with other options.
+    struct Reset {
+        ResetFn reset;
+        uint32_t index;
+    };
+    const std::vector<Reset>& resets() const {
+        return resets_;
     }
-    template<class T>
-    static bool parse(std::string_view str, std::optional<T>& value) {
-        return parse(str, value.emplace());
+    size_t indexOf(const Option& opt) const {
+        return &opt - options_.data();
     }
-    static bool parseFlag(void* value, std::string_view /*str*/) {
-        *static_cast<bool*>(value) = true;
-        return true;
+    const OptionInfo& infoOf(const Option& opt) const {
+        return infos_[indexOf(opt)];
     }
-    template<class T>
-    static bool parseValue(void* value, std::string_view str) {
-        return parse(str, *static_cast<T*>(value));
+
+    const Option* findOption(int position) const;
+    const Option* findOption(char optChar) const;
+    const Option* findOption(std::string_view name) const;
+    bool hasPosArg() const {
+        return hasPosArg_;
     }
-    template<class T, class Alloc>
-    static bool parseList(void* value, std::string_view str) {
-        auto& list = *static_cast<std::vector<T, Alloc>*>(value);
-        return parse(str, list.emplace_back());
+    bool isFlagCluster(std::string_view chars) const {
+        return flagMask_.all(chars);
     }
+    // Binds named options to environment variables: prefix followed by the
+    // name in upper case with '-' and '.' replaced by '_'. Options added
+    // later are bound as well.
+    void bindEnv(std::string_view prefix);
+    // Option bound to a "NAME=value" environment entry and its value.
+    // Entries without the prefix are rejected before anything is hashed.
+    const Option* findEnvOption(
+        std::string_view entry, std::string_view& value) const;
+
+private:
+    void indexOption(size_t index);
+    void rehashNames(size_t slotCount);
+    bool insertName(uint32_t index);
+    void insertEnvName(uint32_t index);
+
+private:
+    std::vector<Option> options_;
+    std::vector<OptionInfo> infos_;
+    std::vector<Reset> resets_;
+    // Open addressing table of long names: option index + 1, 0 is empty.
+    std::vector<uint32_t> nameIndex_;
+    size_t nameCount_ = 0;
+    // Same for environment variable names, sized as nameIndex_ once bound.
+    std::vector<uint32_t> envIndex_;
+    std::string_view envPrefix_;
+    bool envBound_ = false;
+    // Short flag character to option index + 1, 0 is unknown.
+    std::array<uint32_t, 256> flagIndex_{};
+    // Short flag characters bound to boolean flag options.
+    CharMask flagMask_;
+    // Positional argument number to option index + 1, 0 is unbound.
+    std::vector<uint32_t> positionIndex_;
+    // Last option registered with position -1, takes unbound positions.
+    uint32_t catchAllIndex_ = 0;
+    bool hasPosArg_ = false;
+};
+
+} // namespace detail
 
+// State of one parse: parsed marks, program name and error. A
+// CommandLineSchema is shared between threads, each thread parses with its
+// own ParseState.
+class ParseState {
 public:
+    ParseState() = default;
+    // Copies the parsed marks, program name and error. Response and config
+    // files stay mapped by the original only, values that point into them
+    // are valid as long as the original state keeps them.
+    ParseState(const ParseState& other)
+        : parsed_(other.parsed_)
+        , program_(other.program_)
+        , error_(other.error_) {
+    }
+    ParseState& operator=(const ParseState& other) {
+        if(this != &other)
+            *this = ParseState(other);
+        return *this;
+    }
+    ParseState(ParseState&&) = default;
+    ParseState& operator=(ParseState&&) = default;
+
+    std::string_view program() const {
+        return program_;
+    }
+    const std::string& error() const {
+        return error_.message();
+    }
+    const ParseErrorInfo& errorInfo() const {
+        return error_.info();
+    }
+    // Writes the error message as zero terminated text into data without
+    // allocating, returns its length.
+    size_t formatError(char* data, size_t size) const {
+        return error_.format(data, size);
+    }
+    // Clears parsed marks and the error and unmaps response files, so
+    // values that point into them are no longer valid. Allocated capacity
+    // is kept.
+    void reset() {
+        std::fill(parsed_.begin(), parsed_.end(), false);
+        error_.clear();
+        files_.clear();
+        args_.clear();
+    }
+
+private:
+    friend class CommandLineParser;
+    template<class Target>
+    friend class CommandLineSchema;
+
+    static constexpr int maxResponseFileDepth = 32;
+
+    bool checkRequired(const detail::OptionTable& table);
+    template<class Parser>
+    bool parse(Parser& parser, bool responseFiles, int argc, char** argv);
+    template<class Parser, detail::ArgRange Args>
+    bool parse(Parser& parser, bool responseFiles, Args&& args);
+    template<class Parser>
+    bool parse(Parser& parser, bool responseFiles, std::string_view cmdline);
+    template<class Args>
+    bool expandResponseFiles(Args&& args);
+    template<class Parser>
+    bool parseFile(Parser& parser, std::string_view path);
+    template<class Parser>
+    bool parseEnv(Parser& parser, char** envp);
+    bool includeResponseFile(std::string_view path, int argIndex, int depth);
+
+private:
+    std::vector<uint8_t> parsed_;
+    std::string_view program_;
+    detail::ErrorState error_;
+    // Mapped response files, expanded arguments point into them.
+    std::vector<detail::MappedFile> files_;
+    // Command line with response files expanded or split from a string.
+    std::vector<std::string_view> args_;
+    // Words of a command line string that had quotes or escapes.
+    std::string scratch_;
+    // Config file path and dotted option name for parseFile() errors.
+    std::string path_;
+    std::string name_;
+};
+
+class CommandLineParser {
+    using OptionType = detail::OptionType;
+    using Option = detail::OptionTable::Option;
+
+public:
+    // Registers the options of a subcommand on its own parser.
+    using CommandFactory = std::function<void(CommandLineParser&)>;
+
+    CommandLineParser() = default;
+    // Copies the options, bound to the same variables, and the state as
+    // ParseState does. Subcommand parsers are not copied, the copy builds
+    // its own on first selection and has no command selected.
+    CommandLineParser(const CommandLineParser& other);
+    CommandLineParser& operator=(const CommandLineParser& other);
+    CommandLineParser(CommandLineParser&&) = default;
+    CommandLineParser& operator=(CommandLineParser&&) = default;
+
     CommandLineParser& addFlag(
-        bool& value, std::string_view spec, std::string_view help = {}) {
-        options_.emplace_back(OptionType::flag, &value, &parseFlag, spec, help);
+        bool& value, const OptionSpec& spec, std::string_view help = {}) {
+        addOption(
+            OptionType::flag, &value, &detail::parseFlag, &detail::resetFlag,
+            sizeof(bool), spec, help);
         return *this;
     }
     template<class T>
     CommandLineParser& add(
-        T& value, std::string_view spec, std::string_view help = {},
+        T& value, const OptionSpec& spec, std::string_view help = {},
         int position = 0) {
-        options_.emplace_back(
-            OptionType::param, &value, &parseValue<T>, spec, help, position);
+        using Traits = detail::ValueTraits<T>;
+        addOption(
+            Traits::isList ? OptionType::list : OptionType::param, &value,
+            Traits::parse, Traits::reset, Traits::size, spec, help, position);
         return *this;
     }
-    template<class T, class Alloc>
+    CommandLineParser& addFlag(
+        bool& value, std::string_view spec, std::string_view help = {}) {
+        return addFlag(value, OptionSpec::split(spec), help);
+    }
+    template<class T>
     CommandLineParser& add(
-        std::vector<T, Alloc>& value, std::string_view spec,
-        std::string_view help = {}, int position = 0) {
-        options_.emplace_back(
-            OptionType::list, &value, &parseList<T, Alloc>, spec, help,
-            position);
+        T& value, std::string_view spec, std::string_view help = {},
+        int position = 0) {
+        return add(value, OptionSpec::split(spec), help, position);
+    }
+
+    // Adds a git-style subcommand: "tool build --jobs 8". The first
+    // positional argument selects the command, the arguments after it are
+    // parsed by the command's own parser. Its options are only registered,
+    // by calling factory, once the command is selected, so unused commands
+    // cost a trie entry each.
+    CommandLineParser& addCommand(
+        std::string_view name, CommandFactory factory,
+        std::string_view help = {}) {
+        commandTrie_.insert(name, static_cast<uint32_t>(commands_.size()));
+        commands_.emplace_back(name, help, std::move(factory));
         return *this;
     }
+    // Name of the command selected by the last parse, empty if none.
+    std::string_view command() const {
+        return command_ ? commands_[command_ - 1].name : std::string_view();
+    }
+    // Parser of the selected command, nullptr if none.
+    CommandLineParser* commandParser() const {
+        return command_ ? commands_[command_ - 1].parser.get() : nullptr;
+    }
 
     CommandLineParser& setProgram(std::string_view name) {
-        program_ = name;
+        state_.program_ = name;
         return *this;
     }
     CommandLineParser& skipUnknown(bool value = true) {
@@ -94,243 +1087,1170 @@ public:
     bool skipUnknown() const {
         return skipUnknown_;
     }
+    // Replaces "@path" arguments with the arguments read from the file, see
+    // detail::ShellReader for the syntax. Files may include other files.
+    // They stay mapped until reset() or destruction, string_view values
+    // point into them.
+    CommandLineParser& responseFiles(bool value = true) {
+        responseFiles_ = value;
+        return *this;
+    }
+    bool responseFiles() const {
+        return responseFiles_;
+    }
+    // Binds options with a long name to environment variables for
+    // parseEnv(): with prefix "MYTOOL_" option "build.jobs" is read from
+    // MYTOOL_BUILD_JOBS. Flags take true, false, 1 or 0, an empty variable
+    // leaves the flag unset.
+    CommandLineParser& envPrefix(std::string_view prefix) {
+        table_.bindEnv(prefix);
+        return *this;
+    }
     const std::string& error() const {
-        return error_;
+        return state_.error();
+    }
+    const ParseErrorInfo& errorInfo() const {
+        return state_.errorInfo();
+    }
+    size_t formatError(char* data, size_t size) const {
+        return state_.formatError(data, size);
     }
 
+    // Clears the state left by the previous parse: parsed marks, the error,
+    // flag values and list contents. Options, lookup tables and reserved
+    // capacity are kept, so one parser can parse many command lines without
+    // allocating. Other option values are left as they are.
+    void reset();
     bool checkRequired();
     bool parse(int argc, char** argv);
+    // Parses arguments without the program name from any forward range of
+    // string-like elements, e.g. std::vector<std::string>. argIndex in
+    // errors counts them from 1, as if argv[0] came first.
+    template<detail::ArgRange Args>
+    bool parse(Args&& args) {
+        return state_.parse(*this, responseFiles_, std::forward<Args>(args));
+    }
+    // Splits the arguments, without the program name, the way a POSIX shell
+    // does (see detail::ShellReader) and parses them. Values point into
+    // cmdline, or into a scratch buffer of the parser for words that had
+    // quotes or escapes, which stays valid until the next parse or reset().
+    bool parse(std::string_view cmdline);
+    // Sets options from a config file, see detail::ConfigReader for the
+    // syntax. A key in a section names the option "section.key", flags take
+    // true, false, 1 or 0, each value of a list option is appended. Options
+    // count as given for checkRequired(). A later parse() of argv overrides
+    // scalar values, list values are appended after those read from the
+    // file. The file stays mapped until reset() or destruction.
+    bool parseFile(std::string_view path);
+    // Sets options from environment variables bound by envPrefix() in one
+    // pass over envp. Call it after parse(): options already given on the
+    // command line or by parseFile() keep their values.
+    bool parseEnv(char** envp);
+#if __has_include(<sys/mman.h>)
+    bool parseEnv() {
+        return parseEnv(environ);
+    }
+#endif
 
     std::string getHelp() const;
 
 private:
-    Option* findOption(int position);
-    Option* findOption(char optChar);
-    Option* findOption(std::string_view name);
-    bool parseOption(Option& opt, std::string_view value);
-    static size_t formatOptName(const Option& opt, std::string& result);
-    void formatArgError(std::string_view msg, std::string_view arg) {
-        error_ += msg;
-        error_ += ": "sv;
-        error_ += arg;
+    template<class Parser, class Args>
+    friend bool detail::parseArgs(Parser&, detail::ErrorState&, Args&&);
+    friend class ParseState;
+    template<detail::FixedString... Names>
+    friend class MultiCall;
+
+    struct Command {
+        Command(
+            std::string_view name, std::string_view help,
+            CommandFactory factory)
+            : name(name), help(help), factory(std::move(factory)) {
+        }
+        // A copy has the factory, not the built parser.
+        Command(const Command& other)
+            : name(other.name), help(other.help), factory(other.factory) {
+        }
+        Command(Command&&) = default;
+        Command& operator=(Command&&) = default;
+
+        std::string_view name;
+        std::string_view help;
+        CommandFactory factory;
+        // Built on first selection.
+        std::unique_ptr<CommandLineParser> parser;
+        // "program command" for the help of the command. Held by pointer,
+        // the parser keeps a view of it while commands_ may reallocate.
+        std::unique_ptr<std::string> program;
+    };
+
+    bool hasCommands() const {
+        return !commands_.empty();
+    }
+    Command* findCommand(std::string_view name) {
+        auto index = commandTrie_.find(name);
+        return index ? &commands_[index - 1] : nullptr;
+    }
+    template<class It, class End>
+    bool parseCommand(Command& command, int argIndex, It first, End last);
+    // Makes error indexes count from an outer argv, for MultiCall.
+    void offsetArgIndex(int offset) {
+        state_.error_.offsetArgIndex(offset);
+    }
+
+    // Not a template, so options of any type share one copy.
+    void addOption(
+        OptionType type, void* value, detail::ParseFn parse,
+        detail::ResetFn reset, size_t size, const OptionSpec& spec,
+        std::string_view help, int position = 0);
+    template<class Key>
+    const Option* findOption(Key key) const {
+        return table_.findOption(key);
+    }
+    const Option* findEnvOption(
+        std::string_view entry, std::string_view& value) const {
+        return table_.findEnvOption(entry, value);
+    }
+    bool hasPosArg() const {
+        return table_.hasPosArg();
+    }
+    bool isFlagCluster(std::string_view chars) const {
+        return table_.isFlagCluster(chars);
+    }
+    bool parseOption(const Option& opt, std::string_view value) {
+        state_.parsed_[table_.indexOf(opt)] = true;
+        return opt.parse(opt.value, value, opt.size);
+    }
+    void setFlag(const Option& opt) {
+        parseOption(opt, {});
+    }
+    bool isParsed(const Option& opt) const {
+        return state_.parsed_[table_.indexOf(opt)];
+    }
+    size_t indexOf(const Option& opt) const {
+        return table_.indexOf(opt);
+    }
+    const detail::OptionInfo& infoOf(const Option& opt) const {
+        return table_.infoOf(opt);
+    }
+
+private:
+    bool skipUnknown_ = false;
+    bool responseFiles_ = false;
+    detail::OptionTable table_;
+    ParseState state_;
+    std::vector<Command> commands_;
+    detail::NameTrie commandTrie_;
+    // Selected command index + 1, 0 is none.
+    size_t command_ = 0;
+};
+
+// Options bound to members of Target instead of variables. Parsing does not
+// modify the schema, so once all options are added one schema can be used
+// by any number of threads without locks, each thread parsing into its own
+// Target with its own ParseState:
+//   CommandLineSchema<Config> schema;
+//   schema.add<&Config::level>("+level,l", "compression level");
+//   ...
+//   ParseState state;
+//   Config config;
+//   if(!schema.parse(state, config, argc, argv))
+//       log(state.error());
+template<class Target>
+class CommandLineSchema {
+    using OptionType = detail::OptionType;
+    using Option = detail::OptionTable::Option;
+
+public:
+    template<bool Target::*Member>
+    CommandLineSchema& addFlag(
+        const OptionSpec& spec, std::string_view help = {}) {
+        return addOption(
+            OptionType::flag, &detail::parseMember<Member, &detail::parseFlag>,
+            &detail::resetMember<Member, &detail::resetFlag>, sizeof(bool),
+            spec, help);
+    }
+    template<auto Member>
+    CommandLineSchema& add(
+        const OptionSpec& spec, std::string_view help = {},
+        int position = 0) {
+        using Traits = detail::ValueTraits<
+            typename detail::MemberTraits<decltype(Member)>::Type>;
+        static_assert(std::is_same_v<
+                      typename detail::MemberTraits<decltype(Member)>::Class,
+                      Target>);
+        detail::ResetFn reset = nullptr;
+        if constexpr(Traits::reset != nullptr)
+            reset = &detail::resetMember<Member, Traits::reset>;
+        return addOption(
+            Traits::isList ? OptionType::list : OptionType::param,
+            &detail::parseMember<Member, Traits::parse>, reset, Traits::size,
+            spec, help, position);
+    }
+    template<bool Target::*Member>
+    CommandLineSchema& addFlag(
+        std::string_view spec, std::string_view help = {}) {
+        return addFlag<Member>(OptionSpec::split(spec), help);
+    }
+    template<auto Member>
+    CommandLineSchema& add(
+        std::string_view spec, std::string_view help = {}, int position = 0) {
+        return add<Member>(OptionSpec::split(spec), help, position);
+    }
+
+    CommandLineSchema& setProgram(std::string_view name) {
+        program_ = name;
+        return *this;
+    }
+    CommandLineSchema& skipUnknown(bool value = true) {
+        skipUnknown_ = value;
+        return *this;
+    }
+    bool skipUnknown() const {
+        return skipUnknown_;
+    }
+    // Same as CommandLineParser::responseFiles(), files stay mapped until
+    // the state is reset or destroyed.
+    CommandLineSchema& responseFiles(bool value = true) {
+        responseFiles_ = value;
+        return *this;
+    }
+    bool responseFiles() const {
+        return responseFiles_;
+    }
+    // Same as CommandLineParser::envPrefix().
+    CommandLineSchema& envPrefix(std::string_view prefix) {
+        table_.bindEnv(prefix);
+        return *this;
+    }
+
+    bool parse(
+        ParseState& state, Target& target, int argc, char** argv) const {
+        state.parsed_.resize(table_.options().size());
+        Run run{*this, state, target};
+        return state.parse(run, responseFiles_, argc, argv);
+    }
+    // Same as CommandLineParser::parse(Args&&).
+    template<detail::ArgRange Args>
+    bool parse(ParseState& state, Target& target, Args&& args) const {
+        state.parsed_.resize(table_.options().size());
+        Run run{*this, state, target};
+        return state.parse(run, responseFiles_, std::forward<Args>(args));
+    }
+    // Same as CommandLineParser::parse(std::string_view).
+    bool parse(
+        ParseState& state, Target& target, std::string_view cmdline) const {
+        state.parsed_.resize(table_.options().size());
+        Run run{*this, state, target};
+        return state.parse(run, responseFiles_, cmdline);
+    }
+    // Same as CommandLineParser::parseFile().
+    bool parseFile(
+        ParseState& state, Target& target, std::string_view path) const {
+        state.parsed_.resize(table_.options().size());
+        Run run{*this, state, target};
+        return state.parseFile(run, path);
+    }
+    // Same as CommandLineParser::parseEnv().
+    bool parseEnv(ParseState& state, Target& target, char** envp) const {
+        state.parsed_.resize(table_.options().size());
+        Run run{*this, state, target};
+        return state.parseEnv(run, envp);
+    }
+#if __has_include(<sys/mman.h>)
+    bool parseEnv(ParseState& state, Target& target) const {
+        return parseEnv(state, target, environ);
+    }
+#endif
+    bool checkRequired(ParseState& state) const {
+        state.parsed_.resize(table_.options().size());
+        return state.checkRequired(table_);
+    }
+    // Clears the state and, as CommandLineParser::reset() does, the flag and
+    // list values of target.
+    void reset(ParseState& state, Target& target) const {
+        for(auto& entry : table_.resets())
+            entry.reset(&target);
+        state.reset();
+    }
+
+    std::string getHelp() const {
+        return detail::formatHelp(program_, table_.infos());
+    }
+    // Help with the program name taken from the parsed command line.
+    std::string getHelp(const ParseState& state) const {
+        auto program = state.program().empty() ? program_ : state.program();
+        return detail::formatHelp(program, table_.infos());
+    }
+
+private:
+    // Shared by all members, add() only adds the member's thunks.
+    CommandLineSchema& addOption(
+        OptionType type, detail::ParseFn parse, detail::ResetFn reset,
+        size_t size, const OptionSpec& spec, std::string_view help,
+        int position = 0) {
+        table_.add(type, nullptr, parse, reset, size, spec, help, position);
+        return *this;
+    }
+
+    // Binds the shared schema to one state and target for the parse loop.
+    struct Run {
+        const CommandLineSchema& schema;
+        ParseState& state;
+        Target& target;
+
+        void setProgram(std::string_view name) {
+            state.program_ = name;
+        }
+        bool skipUnknown() const {
+            return schema.skipUnknown_;
+        }
+        template<class Key>
+        const Option* findOption(Key key) const {
+            return schema.table_.findOption(key);
+        }
+        const Option* findEnvOption(
+            std::string_view entry, std::string_view& value) const {
+            return schema.table_.findEnvOption(entry, value);
+        }
+        bool hasPosArg() const {
+            return schema.table_.hasPosArg();
+        }
+        bool isFlagCluster(std::string_view chars) const {
+            return schema.table_.isFlagCluster(chars);
+        }
+        bool parseOption(const Option& opt, std::string_view value) {
+            state.parsed_[schema.table_.indexOf(opt)] = true;
+            return opt.parse(&target, value, opt.size);
+        }
+        void setFlag(const Option& opt) {
+            parseOption(opt, {});
+        }
+        bool isParsed(const Option& opt) const {
+            return state.parsed_[schema.table_.indexOf(opt)];
+        }
+        size_t indexOf(const Option& opt) const {
+            return schema.table_.indexOf(opt);
+        }
+        const detail::OptionInfo& infoOf(const Option& opt) const {
+            return schema.table_.infoOf(opt);
+        }
+    };
+
+private:
+    std::string_view program_;
+    bool skipUnknown_ = false;
+    bool responseFiles_ = false;
+    detail::OptionTable table_;
+};
+
+#ifdef COMMAND_LINE_PARSER_DEFINITIONS
+
+COMMAND_LINE_PARSER_INLINE CommandLineParser::CommandLineParser(
+    const CommandLineParser& other)
+    : skipUnknown_(other.skipUnknown_)
+    , responseFiles_(other.responseFiles_)
+    , table_(other.table_)
+    , state_(other.state_)
+    , commands_(other.commands_)
+    , commandTrie_(other.commandTrie_) {
+}
+
+COMMAND_LINE_PARSER_INLINE CommandLineParser& CommandLineParser::operator=(
+    const CommandLineParser& other) {
+    if(this != &other)
+        *this = CommandLineParser(other);
+    return *this;
+}
+
+COMMAND_LINE_PARSER_INLINE void CommandLineParser::reset() {
+    for(auto& entry : table_.resets())
+        entry.reset(table_.options()[entry.index].value);
+    state_.reset();
+    if(auto* parser = commandParser())
+        parser->reset();
+    command_ = 0;
+}
+
+COMMAND_LINE_PARSER_INLINE bool CommandLineParser::checkRequired() {
+    if(!state_.checkRequired(table_))
+        return false;
+    auto* parser = commandParser();
+    if(!parser || parser->checkRequired())
+        return true;
+    state_.error_ = parser->state_.error_;
+    return false;
+}
+
+COMMAND_LINE_PARSER_INLINE void CommandLineParser::addOption(
+    OptionType type, void* value, detail::ParseFn parse, detail::ResetFn reset,
+    size_t size, const OptionSpec& spec, std::string_view help, int position) {
+    table_.add(type, value, parse, reset, size, spec, help, position);
+    state_.parsed_.push_back(false);
+}
+
+COMMAND_LINE_PARSER_INLINE bool CommandLineParser::parse(
+    int argc, char** argv) {
+    return state_.parse(*this, responseFiles_, argc, argv);
+}
+
+COMMAND_LINE_PARSER_INLINE bool CommandLineParser::parse(
+    std::string_view cmdline) {
+    return state_.parse(*this, responseFiles_, cmdline);
+}
+
+COMMAND_LINE_PARSER_INLINE bool CommandLineParser::parseFile(
+    std::string_view path) {
+    return state_.parseFile(*this, path);
+}
+
+COMMAND_LINE_PARSER_INLINE bool CommandLineParser::parseEnv(char** envp) {
+    return state_.parseEnv(*this, envp);
+}
+
+#endif
+
+template<class It, class End>
+bool CommandLineParser::parseCommand(
+    Command& command, int argIndex, It first, End last) {
+    if(!command.parser) {
+        command.parser = std::make_unique<CommandLineParser>();
+        command.factory(*command.parser);
+        command.program = std::make_unique<std::string>();
+    }
+    command_ = &command - commands_.data() + 1;
+    auto& program = *command.program;
+    program = state_.program_;
+    program += ' ';
+    program += command.name;
+    command.parser->setProgram(program);
+    detail::ArgSlice<It, End> rest{first, last};
+    if(command.parser->parse(rest))
+        return true;
+    state_.error_ = command.parser->state_.error_;
+    state_.error_.offsetArgIndex(argIndex);
+    return false;
+}
+
+#ifdef COMMAND_LINE_PARSER_DEFINITIONS
+
+COMMAND_LINE_PARSER_INLINE std::string CommandLineParser::getHelp() const {
+    auto result = detail::formatHelp(state_.program_, table_.infos());
+    if(commands_.empty())
+        return result;
+    result.insert(result.find('\n'), " <command> [args]"sv);
+    size_t maxNameLen = 0;
+    for(auto& command : commands_)
+        maxNameLen = std::max(maxNameLen, command.name.size());
+    if(maxNameLen > 30)
+        maxNameLen = 30;
+    result += "commands:\n"sv;
+    for(auto& command : commands_) {
+        result += "  "sv;
+        result += command.name;
+        if(command.name.size() < maxNameLen)
+            result.append(maxNameLen - command.name.size(), ' ');
+        if(!command.help.empty()) {
+            result += " : "sv;
+            result += command.help;
+        }
+        result += '\n';
+    }
+    return result;
+}
+
+COMMAND_LINE_PARSER_INLINE bool ParseState::checkRequired(
+    const detail::OptionTable& table) {
+    auto& infos = table.infos();
+    for(size_t i = 0; i < infos.size(); ++i) {
+        if(!infos[i].required || parsed_[i])
+            continue;
+        error_.set(ParseError::requiredMissing, 0, infos[i].name, infos[i], i);
+        return false;
+    }
+    return true;
+}
+
+#endif
+
+template<class Parser>
+bool ParseState::parse(
+    Parser& parser, bool responseFiles, int argc, char** argv) {
+    if(argc <= 0)
+        return true;
+    parser.setProgram(detail::programName(argv[0]));
+    return parse(parser, responseFiles, std::span(argv + 1, argc - 1));
+}
+
+template<class Parser, detail::ArgRange Args>
+bool ParseState::parse(Parser& parser, bool responseFiles, Args&& args) {
+    if(responseFiles) {
+        for(std::string_view arg : args) {
+            if(arg.size() > 1 && arg[0] == '@') {
+                if(!expandResponseFiles(args))
+                    return false;
+                return detail::parseArgs(parser, error_, args_);
+            }
+        }
+    }
+    return detail::parseArgs(parser, error_, std::forward<Args>(args));
+}
+
+template<class Parser>
+bool ParseState::parse(
+    Parser& parser, bool responseFiles, std::string_view cmdline) {
+    // Unescaped words are never longer than their text, so the buffer does
+    // not grow while views into it are taken.
+    if(scratch_.size() < cmdline.size())
+        scratch_.resize(cmdline.size());
+    detail::ShellReader reader(cmdline.data(), cmdline.size(), scratch_.data());
+    args_.clear();
+    std::string_view word;
+    while(reader.next(word)) {
+        auto argIndex = static_cast<int>(args_.size() + 1);
+        if(responseFiles && reader.isInclude() && word.size() > 1) {
+            if(!includeResponseFile(word.substr(1), argIndex, 1))
+                return false;
+        }
+        else
+            args_.push_back(word);
+    }
+    if(reader.failed()) {
+        error_.set(
+            ParseError::unterminatedCommandQuote,
+            static_cast<int>(args_.size() + 1), reader.rest());
+        return false;
+    }
+    return detail::parseArgs(parser, error_, args_);
+}
+
+template<class Args>
+bool ParseState::expandResponseFiles(Args&& args) {
+    args_.clear();
+    int argIndex = 0;
+    for(std::string_view arg : args) {
+        ++argIndex;
+        if(arg.size() < 2 || arg[0] != '@')
+            args_.push_back(arg);
+        else if(!includeResponseFile(arg.substr(1), argIndex, 1))
+            return false;
+    }
+    return true;
+}
+
+#ifdef COMMAND_LINE_PARSER_DEFINITIONS
+
+COMMAND_LINE_PARSER_INLINE bool ParseState::includeResponseFile(
+    std::string_view path, int argIndex, int depth) {
+    if(depth > maxResponseFileDepth) {
+        error_.set(ParseError::responseFileNesting, argIndex, path);
+        return false;
+    }
+    detail::MappedFile file;
+    if(!file.open(std::string(path).c_str())) {
+        error_.set(ParseError::responseFileUnreadable, argIndex, path);
+        return false;
+    }
+    detail::ShellReader reader(file.data(), file.size());
+    // The mapping stays in place when the vector grows.
+    files_.push_back(std::move(file));
+    std::string_view arg;
+    while(reader.next(arg)) {
+        if(reader.isInclude() && arg.size() > 1) {
+            if(!includeResponseFile(arg.substr(1), argIndex, depth + 1))
+                return false;
+        }
+        else
+            args_.push_back(arg);
+    }
+    if(!reader.failed())
+        return true;
+    error_.set(ParseError::unterminatedQuote, argIndex, path);
+    return false;
+}
+
+#endif
+
+template<class Parser>
+bool ParseState::parseFile(Parser& parser, std::string_view path) {
+    path_ = path;
+    detail::MappedFile file;
+    if(!file.open(path_.c_str())) {
+        error_.set(ParseError::configFileUnreadable, 0, path_);
+        return false;
+    }
+    detail::ConfigReader reader(file.data(), file.size());
+    files_.push_back(std::move(file));
+    bool skipUnknown = std::as_const(parser).skipUnknown();
+    std::string_view key;
+    std::string_view value;
+    while(reader.next(key, value)) {
+        auto name = key;
+        if(!reader.section().empty()) {
+            name_ = reader.section();
+            name_ += '.';
+            name_ += key;
+            name = name_;
+        }
+        auto option = parser.findOption(name);
+        if(!option) {
+            if(skipUnknown)
+                continue;
+            error_.set(ParseError::unknownOption, reader.line(), name);
+            return false;
+        }
+        if(!parser.parseOption(*option, value)) {
+            error_.set(
+                ParseError::invalidValue, reader.line(), value,
+                parser.infoOf(*option), parser.indexOf(*option));
+            return false;
+        }
+    }
+    if(!reader.failed())
+        return true;
+    error_.set(ParseError::configFileSyntax, reader.line(), path_);
+    return false;
+}
+
+template<class Parser>
+bool ParseState::parseEnv(Parser& parser, char** envp) {
+    for(; *envp; ++envp) {
+        std::string_view entry = *envp;
+        std::string_view value;
+        auto option = parser.findEnvOption(entry, value);
+        if(!option)
+            continue;
+        auto index = parser.indexOf(*option);
+        if(parsed_[index]
+           || (value.empty() && option->type == detail::OptionType::flag))
+            continue;
+        if(!parser.parseOption(*option, value)) {
+            error_.set(
+                ParseError::invalidEnvValue, 0, entry, parser.infoOf(*option),
+                index);
+            return false;
+        }
+    }
+    return true;
+}
+
+namespace detail {
+
+#ifdef COMMAND_LINE_PARSER_DEFINITIONS
+
+#if __has_include(<sys/mman.h>)
+COMMAND_LINE_PARSER_INLINE bool MappedFile::open(const char* path) {
+    close();
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        return false;
+    struct stat info;
+    bool ok = ::fstat(fd, &info) == 0 && S_ISREG(info.st_mode);
+    if(ok && info.st_size > 0) {
+        void* data = ::mmap(
+            nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ok = data != MAP_FAILED;
+        if(ok) {
+            data_ = static_cast<char*>(data);
+            size_ = info.st_size;
+        }
+    }
+    ::close(fd);
+    return ok;
+}
+
+COMMAND_LINE_PARSER_INLINE void MappedFile::close() {
+    if(data_)
+        ::munmap(data_, size_);
+    data_ = nullptr;
+    size_ = 0;
+}
+#else
+// Without mmap the file is read into a buffer of its own.
+COMMAND_LINE_PARSER_INLINE bool MappedFile::open(const char* path) {
+    close();
+    std::FILE* file = std::fopen(path, "rb");
+    if(!file)
+        return false;
+    bool ok = std::fseek(file, 0, SEEK_END) == 0;
+    long size = ok ? std::ftell(file) : -1;
+    ok = size >= 0 && std::fseek(file, 0, SEEK_SET) == 0;
+    if(ok && size > 0) {
+        data_ = new char[size];
+        size_ = size;
+        ok = std::fread(data_, 1, size_, file) == size_;
+    }
+    std::fclose(file);
+    if(!ok)
+        close();
+    return ok;
+}
+
+COMMAND_LINE_PARSER_INLINE void MappedFile::close() {
+    delete[] data_;
+    data_ = nullptr;
+    size_ = 0;
+}
+#endif
+
+// Reads the decimal digits from pos on into value and returns their count.
+// While eight bytes are left they are tested and combined in one step with
+// SWAR arithmetic, then four. Past 19 digits value has wrapped around.
+inline size_t readDigits(const char*& pos, const char* end, uint64_t& value) {
+    auto start = pos;
+    if constexpr(std::endian::native == std::endian::little) {
+        // '0' to '9' have high nibble 3, and keep it when 6 is added.
+        auto allDigits = [](auto word) {
+            using Word = decltype(word);
+            constexpr auto ones = static_cast<Word>(0x0101010101010101ull);
+            constexpr Word highs = ones * 0xF0;
+            return ((word & highs) | (((word + ones * 6) & highs) >> 4))
+                == ones * 0x33;
+        };
+        constexpr uint64_t zeros = 0x3030303030303030ull;
+        constexpr uint64_t pairs = 0x000000FF000000FFull;
+        while(end - pos >= 8) {
+            uint64_t word;
+            std::memcpy(&word, pos, sizeof(word));
+            if(!allDigits(word))
+                break;
+            // Digits to two digit, then to four and eight digit numbers.
+            word -= zeros;
+            word = word * 10 + (word >> 8);
+            word = ((word & pairs) * (100 + (1000000ull << 32))
+                    + ((word >> 16) & pairs) * (1 + (10000ull << 32)))
+                >> 32;
+            value = value * 100000000 + static_cast<uint32_t>(word);
+            pos += 8;
+        }
+        if(end - pos >= 4) {
+            uint32_t word;
+            std::memcpy(&word, pos, sizeof(word));
+            if(allDigits(word)) {
+                word -= static_cast<uint32_t>(zeros);
+                word = word * 10 + (word >> 8);
+                value = value * 10000 + (word & 0xFF) * 100
+                      + ((word >> 16) & 0xFF);
+                pos += 4;
+            }
+        }
+    }
+    for(; pos != end && static_cast<unsigned char>(*pos - '0') < 10; ++pos)
+        value = value * 10 + static_cast<unsigned char>(*pos - '0');
+    return pos - start;
+}
+
+template<class T, class Int>
+bool storeInt(void* value, Int result) {
+    if(!std::in_range<T>(result))
+        return false;
+    auto item = static_cast<T>(result);
+    std::memcpy(value, &item, sizeof(T));
+    return true;
+}
+
+COMMAND_LINE_PARSER_INLINE bool parseSigned(
+    void* value, std::string_view str, size_t size) {
+    auto end = str.data() + str.size();
+    bool negative = !str.empty() && str[0] == '-';
+    auto pos = str.data() + negative;
+    uint64_t magnitude = 0;
+    size_t digits = readDigits(pos, end, magnitude);
+    if(pos != end || digits == 0)
+        return false;
+    int64_t result = 0;
+    if(digits > 19) {
+        // May overflow, std::from_chars tells.
+        if(std::from_chars(str.data(), end, result).ec != std::errc{})
+            return false;
+    }
+    else if(magnitude > uint64_t(INT64_MAX) + negative)
+        return false;
+    else
+        result = static_cast<int64_t>(negative ? 0 - magnitude : magnitude);
+    switch(size) {
+    case 1:
+        return storeInt<int8_t>(value, result);
+    case 2:
+        return storeInt<int16_t>(value, result);
+    case 4:
+        return storeInt<int32_t>(value, result);
+    default:
+        return storeInt<int64_t>(value, result);
+    }
+}
+
+COMMAND_LINE_PARSER_INLINE bool parseUnsigned(
+    void* value, std::string_view str, size_t size) {
+    auto end = str.data() + str.size();
+    auto pos = str.data();
+    // A 20th digit may overflow and is added with a check.
+    auto last = str.size() == 20 ? end - 1 : end;
+    uint64_t result = 0;
+    size_t digits = readDigits(pos, last, result);
+    if(pos != last || digits == 0)
+        return false;
+    if(last != end) {
+        unsigned digit = static_cast<unsigned char>(*last - '0');
+        if(digit > 9 || result > (UINT64_MAX - digit) / 10)
+            return false;
+        result = result * 10 + digit;
+    }
+    else if(
+        digits > 19
+        && std::from_chars(str.data(), end, result).ec != std::errc{})
+        return false;
+    switch(size) {
+    case 1:
+        return storeInt<uint8_t>(value, result);
+    case 2:
+        return storeInt<uint16_t>(value, result);
+    case 4:
+        return storeInt<uint32_t>(value, result);
+    default:
+        return storeInt<uint64_t>(value, result);
     }
+}
 
-private:
-    std::string_view program_;
-    bool skipUnknown_ = false;
-    std::vector<Option> options_;
-    std::string error_;
-};
+template<class T>
+bool parseFloat(void* value, std::string_view str) {
+    T result;
+    auto end = str.data() + str.size();
+    auto res = std::from_chars(str.data(), end, result);
+    if(res.ec != std::errc{} || res.ptr != end)
+        return false;
+    std::memcpy(value, &result, sizeof(T));
+    return true;
+}
 
-inline CommandLineParser::Option::Option(
-    OptionType type, void* value, ParseFn parse, std::string_view spec,
-    std::string_view help, int position)
-    : type(type), value(value), parse(parse), help(help), position(position) {
-    required = !spec.empty() && spec[0] == '+';
-    if(required)
-        spec.remove_prefix(1);
-    name = spec;
-    auto pos = spec.find(',');
-    if(pos == std::string_view::npos)
-        return;
-    name = spec.substr(0, pos);
-    spec.remove_prefix(pos + 1);
-    flags = spec;
-    pos = spec.find(',');
-    if(pos == std::string_view::npos)
-        return;
-    flags = spec.substr(0, pos);
-    hint = spec.substr(pos + 1);
+COMMAND_LINE_PARSER_INLINE bool parseFloating(
+    void* value, std::string_view str, size_t size) {
+    if(size == sizeof(float))
+        return parseFloat<float>(value, str);
+    if(size == sizeof(double))
+        return parseFloat<double>(value, str);
+    return parseFloat<long double>(value, str);
 }
 
-inline CommandLineParser::Option* CommandLineParser::findOption(int position) {
-    Option* positionalOpt = nullptr;
-    for(auto& opt : options_) {
-        if(opt.position == position)
-            return &opt;
-        if(opt.position == -1)
-            positionalOpt = &opt;
-    }
-    return positionalOpt;
+constexpr bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v'
+        || c == '\f';
 }
 
-inline CommandLineParser::Option* CommandLineParser::findOption(char optChar) {
-    for(auto& opt : options_) {
-        if(opt.flags.find(optChar) != std::string_view::npos)
-            return &opt;
-    }
-    if(!skipUnknown_) {
-        error_ = "unknown option: -"sv;
-        error_ += optChar;
-    }
-    return nullptr;
+constexpr bool isShellSpecial(char c) {
+    return isSpace(c) || c == '\'' || c == '"' || c == '\\';
 }
 
-inline CommandLineParser::Option* CommandLineParser::findOption(
-    std::string_view name) {
-    for(auto& opt : options_) {
-        if(opt.name == name)
-            return &opt;
+// First whitespace, quote or backslash in [pos, end). Eight bytes are tested
+// per step: all of these are below '(' except the backslash, so one SWAR
+// compare against '(' and one against '\\' find candidate words and only
+// those are scanned byte by byte.
+COMMAND_LINE_PARSER_INLINE const char* findShellSpecial(
+    const char* pos, const char* end) {
+    constexpr uint64_t ones = 0x0101010101010101ull;
+    constexpr uint64_t highs = ones * 0x80;
+    constexpr uint64_t backslashes = ones * '\\';
+    while(end - pos >= 8) {
+        uint64_t word;
+        std::memcpy(&word, pos, sizeof(word));
+        uint64_t below = (word - ones * '(') & ~word;
+        uint64_t diff = word ^ backslashes;
+        uint64_t equal = (diff - ones) & ~diff;
+        if((below | equal) & highs)
+            break;
+        pos += 8;
     }
-    if(!skipUnknown_) {
-        error_ = "unknown option: --"sv;
-        error_ += name;
-    }
-    return nullptr;
+    while(pos != end && !isShellSpecial(*pos))
+        ++pos;
+    return pos;
 }
 
-inline bool CommandLineParser::parseOption(Option& opt, std::string_view value) {
-    if(opt.parse(opt.value, value))
+COMMAND_LINE_PARSER_INLINE bool ShellReader::next(std::string_view& word) {
+    while(pos_ != end_ && (isSpace(*pos_) || *pos_ == '#')) {
+        if(*pos_ != '#')
+            ++pos_;
+        else if(auto* eol = std::memchr(pos_, '\n', end_ - pos_))
+            pos_ = static_cast<const char*>(eol);
+        else
+            pos_ = end_;
+    }
+    if(pos_ == end_)
+        return false;
+    begin_ = pos_;
+    include_ = *pos_ == '@';
+    pos_ = findShellSpecial(pos_, end_);
+    if(pos_ == end_ || isSpace(*pos_)) {
+        word = std::string_view(begin_, pos_ - begin_);
         return true;
-    formatArgError("invalid option value"sv, value);
-    return false;
-}
-
-inline bool CommandLineParser::parse(int argc, char** argv) {
-    program_ = argv[0];
-    size_t pathSepPos = program_.find_last_of("/\\"sv);
-    if(pathSepPos != std::string_view::npos)
-        program_ = program_.substr(pathSepPos + 1);
-    bool hasPosArg = false;
-    for(auto& opt : options_) {
-        if(!opt.position)
-            continue;
-        hasPosArg = true;
-        break;
     }
-    int argNum = 1;
-    int position = 0;
-    Option* lastOption = nullptr;
-    bool lastOptionUnknown = false;
-    while(argNum < argc) {
-        std::string_view argValue(argv[argNum++]);
-        auto arg = argValue;
-        if(arg.empty())
-            continue;
-        if(arg[0] != '-') {
-            if(lastOptionUnknown) {
-                lastOptionUnknown = false;
-                continue;
-            }
-            if(lastOption) {
-                lastOption->parsed = true;
-                if(!parseOption(*lastOption, arg))
-                    return false;
-                if(lastOption->type != OptionType::list || hasPosArg)
-                    lastOption = nullptr;
+    char* out = scratch_ ? scratch_ : writable_ + (begin_ - text_);
+    char* last = out;
+    // Memory is only written once unescaping has shifted the output back.
+    auto keep = [&](const char* from, size_t count) {
+        if(last != from)
+            std::memmove(last, from, count);
+        last += count;
+    };
+    keep(begin_, pos_ - begin_);
+    while(pos_ != end_ && !isSpace(*pos_)) {
+        char c = *pos_;
+        if(c == '\'') {
+            auto* close = std::memchr(pos_ + 1, '\'', end_ - pos_ - 1);
+            if(!close) {
+                failed_ = true;
+                return false;
             }
-            else {
-                ++position;
-                auto* option = findOption(position);
-                if(!option) {
-                    formatArgError("positional arg not allowed"sv, argValue);
-                    return false;
+            keep(pos_ + 1, static_cast<const char*>(close) - pos_ - 1);
+            pos_ = static_cast<const char*>(close) + 1;
+        }
+        else if(c == '"') {
+            for(++pos_; pos_ != end_ && *pos_ != '"'; ++pos_) {
+                if(*pos_ == '\\' && end_ - pos_ > 1) {
+                    char next = pos_[1];
+                    if(next == '\n') {
+                        ++pos_;
+                        continue;
+                    }
+                    if(next == '$' || next == '`' || next == '"'
+                       || next == '\\')
+                        ++pos_;
                 }
-                option->parsed = true;
-                if(!parseOption(*option, arg))
-                    return false;
+                keep(pos_, 1);
             }
-            continue;
-        }
-        lastOption = nullptr;
-        lastOptionUnknown = false;
-        arg.remove_prefix(1);
-        bool isName = !arg.empty() && arg[0] == '-';
-        if(isName)
-            arg.remove_prefix(1);
-        if(arg.empty())
-            continue;
-        std::string_view name = arg;
-        std::string_view value;
-        auto eqPos = arg.find('=');
-        if(eqPos == 0) {
-            formatArgError("missing option name"sv, argValue);
-            return false;
+            if(pos_ == end_) {
+                failed_ = true;
+                return false;
+            }
+            ++pos_;
         }
-        bool hasValue = eqPos != std::string_view::npos;
-        if(hasValue) {
-            name = arg.substr(0, eqPos);
-            value = arg.substr(eqPos + 1);
+        else if(c == '\\') {
+            if(++pos_ == end_)
+                break;
+            if(*pos_ != '\n')
+                keep(pos_, 1);
+            ++pos_;
         }
-        Option* option = nullptr;
-        if(isName)
-            option = findOption(name);
-        else if(name.size() == 1)
-            option = findOption(name[0]);
         else {
-            if(hasValue) {
-                formatArgError("flag/argument mix disallowed"sv, argValue);
-                return false;
-            }
-            for(auto optChar : name) {
-                option = findOption(optChar);
-                if(!option) {
-                    if(skipUnknown_)
-                        continue;
-                    return false;
-                }
-                if(option->type != OptionType::flag) {
-                    error_ = "option requires value: "sv;
-                    error_ += optChar;
-                    return false;
-                }
-                option->parsed = true;
-                option->parse(option->value, {});
-            }
-            continue;
+            auto* run = pos_;
+            pos_ = findShellSpecial(pos_, end_);
+            keep(run, pos_ - run);
         }
-        if(!option) {
-            if(skipUnknown_) {
-                lastOptionUnknown = true;
-                continue;
-            }
-            return false;
+    }
+    word = std::string_view(out, last - out);
+    if(scratch_)
+        scratch_ = last;
+    return true;
+}
+
+COMMAND_LINE_PARSER_INLINE uint32_t NameTrie::child(
+    uint32_t node, char c) const {
+    for(auto next = nodes_[node].child; next; next = nodes_[next].sibling) {
+        if(nodes_[next].c == c)
+            return next;
+    }
+    return 0;
+}
+
+COMMAND_LINE_PARSER_INLINE void NameTrie::insert(
+    std::string_view name, uint32_t value) {
+    uint32_t node = 0;
+    for(auto c : name) {
+        auto next = child(node, c);
+        if(!next) {
+            next = static_cast<uint32_t>(nodes_.size());
+            nodes_.push_back({0, nodes_[node].child, 0, c});
+            nodes_[node].child = next;
         }
-        if(option->type == OptionType::flag) {
-            if(hasValue) {
-                formatArgError("option value unexpected"sv, argValue);
-                return false;
-            }
-            option->parsed = true;
-            option->parse(option->value, {});
+        node = next;
+    }
+    if(!nodes_[node].value)
+        nodes_[node].value = value + 1;
+}
+
+COMMAND_LINE_PARSER_INLINE uint32_t NameTrie::find(
+    std::string_view name) const {
+    uint32_t node = 0;
+    for(auto c : name) {
+        node = child(node, c);
+        if(!node)
+            return 0;
+    }
+    return nodes_[node].value;
+}
+
+COMMAND_LINE_PARSER_INLINE void OptionTable::add(
+    OptionType type, void* value, ParseFn parse, ResetFn reset, size_t size,
+    const OptionSpec& spec, std::string_view help, int position) {
+    options_.push_back(
+        {spec.name.data(), static_cast<uint32_t>(spec.name.size()),
+         static_cast<uint16_t>(size), type, value, parse});
+    infos_.push_back(
+        {type, spec.required, spec.name, spec.flags, help, spec.hint,
+         position});
+    if(reset)
+        resets_.push_back({reset, static_cast<uint32_t>(options_.size() - 1)});
+    indexOption(options_.size() - 1);
+}
+
+COMMAND_LINE_PARSER_INLINE void OptionTable::indexOption(size_t index) {
+    auto& opt = infos_[index];
+    for(auto c : opt.flags) {
+        auto byte = static_cast<unsigned char>(c);
+        if(flagIndex_[byte])
             continue;
+        flagIndex_[byte] = static_cast<uint32_t>(index + 1);
+        if(opt.type == OptionType::flag)
+            flagMask_.set(c);
+    }
+    if(opt.position) {
+        hasPosArg_ = true;
+        if(opt.position == -1)
+            catchAllIndex_ = static_cast<uint32_t>(index + 1);
+        else if(opt.position > 0) {
+            size_t position = opt.position;
+            if(position >= positionIndex_.size())
+                positionIndex_.resize(position + 1);
+            if(!positionIndex_[position])
+                positionIndex_[position] = static_cast<uint32_t>(index + 1);
         }
-        if(!hasValue) {
-            lastOption = option;
-            continue;
+    }
+    if(opt.name.empty())
+        return;
+    if((nameCount_ + 1) * 2 > nameIndex_.size())
+        rehashNames(nameIndex_.empty() ? 16 : nameIndex_.size() * 2);
+    if(!insertName(static_cast<uint32_t>(index)))
+        return;
+    ++nameCount_;
+    if(envBound_)
+        insertEnvName(static_cast<uint32_t>(index));
+}
+
+COMMAND_LINE_PARSER_INLINE void OptionTable::rehashNames(size_t slotCount) {
+    std::vector<uint32_t> slots(slotCount);
+    nameIndex_.swap(slots);
+    for(auto slot : slots) {
+        if(slot)
+            insertName(slot - 1);
+    }
+    if(envBound_)
+        bindEnv(envPrefix_);
+}
+
+COMMAND_LINE_PARSER_INLINE bool OptionTable::insertName(uint32_t index) {
+    auto name = options_[index].name();
+    size_t mask = nameIndex_.size() - 1;
+    for(size_t i = hashName(name) & mask;; i = (i + 1) & mask) {
+        auto& slot = nameIndex_[i];
+        if(!slot) {
+            slot = index + 1;
+            return true;
         }
-        option->parsed = true;
-        if(!parseOption(*option, value))
+        // First registered option wins, same as the linear scan did.
+        if(options_[slot - 1].name() == name)
             return false;
-        if(option->type == OptionType::list && !hasPosArg)
-            lastOption = option;
     }
-    if(!lastOption || lastOption->parsed)
-        return true;
-    formatArgError("option requires value"sv, argv[argc - 1]);
-    return false;
 }
 
-inline bool CommandLineParser::checkRequired() {
-    for(auto& opt : options_) {
-        if(!opt.required || opt.parsed)
-            continue;
-        error_ = "required option missing: "sv;
-        formatOptName(opt, error_);
-        return false;
+COMMAND_LINE_PARSER_INLINE void OptionTable::bindEnv(std::string_view prefix) {
+    envPrefix_ = prefix;
+    envBound_ = true;
+    envIndex_.assign(nameIndex_.size(), 0);
+    // Registration order, so the first of two names with the same spelling
+    // wins.
+    for(size_t i = 0; i < infos_.size(); ++i) {
+        if(!infos_[i].name.empty())
+            insertEnvName(static_cast<uint32_t>(i));
     }
-    return true;
 }
 
-inline size_t CommandLineParser::formatOptName(
-    const Option& opt, std::string& result) {
+COMMAND_LINE_PARSER_INLINE void OptionTable::insertEnvName(uint32_t index) {
+    auto name = options_[index].name();
+    size_t mask = envIndex_.size() - 1;
+    for(size_t i = hashEnvName(name) & mask;; i = (i + 1) & mask) {
+        auto& slot = envIndex_[i];
+        if(!slot) {
+            slot = index + 1;
+            return;
+        }
+        auto other = options_[slot - 1].name();
+        if(other.size() == name.size()
+           && std::equal(
+               name.begin(), name.end(), other.begin(),
+               [](char a, char b) { return envChar(a) == envChar(b); }))
+            return;
+    }
+}
+
+COMMAND_LINE_PARSER_INLINE const OptionTable::Option*
+OptionTable::findEnvOption(
+    std::string_view entry, std::string_view& value) const {
+    if(envIndex_.empty() || entry.size() <= envPrefix_.size()
+       || entry.compare(0, envPrefix_.size(), envPrefix_) != 0)
+        return nullptr;
+    entry.remove_prefix(envPrefix_.size());
+    auto eqPos = entry.find('=');
+    if(eqPos == std::string_view::npos)
+        return nullptr;
+    auto var = entry.substr(0, eqPos);
+    size_t mask = envIndex_.size() - 1;
+    for(size_t i = hashName(var) & mask; envIndex_[i]; i = (i + 1) & mask) {
+        auto index = envIndex_[i] - 1;
+        auto name = options_[index].name();
+        if(name.size() == var.size()
+           && std::equal(
+               var.begin(), var.end(), name.begin(),
+               [](char a, char b) { return a == envChar(b); })) {
+            value = entry.substr(eqPos + 1);
+            return &options_[index];
+        }
+    }
+    return nullptr;
+}
+
+COMMAND_LINE_PARSER_INLINE const OptionTable::Option* OptionTable::findOption(
+    int position) const {
+    uint32_t index = catchAllIndex_;
+    if(static_cast<size_t>(position) < positionIndex_.size()
+       && positionIndex_[position])
+        index = positionIndex_[position];
+    return index ? &options_[index - 1] : nullptr;
+}
+
+COMMAND_LINE_PARSER_INLINE const OptionTable::Option* OptionTable::findOption(
+    char optChar) const {
+    if(auto index = flagIndex_[static_cast<unsigned char>(optChar)])
+        return &options_[index - 1];
+    return nullptr;
+}
+
+COMMAND_LINE_PARSER_INLINE const OptionTable::Option* OptionTable::findOption(
+    std::string_view name) const {
+    if(!nameIndex_.empty()) {
+        size_t mask = nameIndex_.size() - 1;
+        for(size_t i = hashName(name) & mask; nameIndex_[i];
+            i = (i + 1) & mask) {
+            auto& opt = options_[nameIndex_[i] - 1];
+            if(opt.name() == name)
+                return &opt;
+        }
+    }
+    return nullptr;
+}
+
+#endif
+
+template<class Text>
+size_t formatOptName(const OptionInfo& opt, Text& result) {
     size_t sz = result.size();
     if(opt.name.empty() && opt.flags.empty()) {
         if(!opt.hint.empty())
             result += opt.hint;
         else {
+            char position[16];
+            auto res = std::to_chars(
+                position, position + sizeof(position), opt.position);
             result += "arg"sv;
-            result += std::to_string(opt.position);
+            result += std::string_view(position, res.ptr - position);
         }
         return result.size() - sz;
     }
@@ -356,17 +2276,178 @@ inline size_t CommandLineParser::formatOptName(
     return result.size() - sz;
 }
 
-inline std::string CommandLineParser::getHelp() const {
+#ifdef COMMAND_LINE_PARSER_DEFINITIONS
+
+COMMAND_LINE_PARSER_INLINE void ConfigReader::skipBlanks() {
+    while(pos_ != end_ && (*pos_ == ' ' || *pos_ == '\t' || *pos_ == '\r'))
+        ++pos_;
+}
+
+COMMAND_LINE_PARSER_INLINE void ConfigReader::skipLine() {
+    auto* eol = std::memchr(pos_, '\n', end_ - pos_);
+    pos_ = eol ? static_cast<char*>(eol) : end_;
+}
+
+// Skips blanks and a comment, true if nothing else is left on the line.
+COMMAND_LINE_PARSER_INLINE bool ConfigReader::endOfLine() {
+    skipBlanks();
+    if(pos_ != end_ && *pos_ == '#')
+        skipLine();
+    return pos_ == end_ || *pos_ == '\n';
+}
+
+COMMAND_LINE_PARSER_INLINE bool ConfigReader::readValue(
+    std::string_view& value) {
+    char* begin = pos_;
+    if(pos_ != end_ && *pos_ == '\'') {
+        ++pos_;
+        auto* close = std::memchr(pos_, '\'', end_ - pos_);
+        auto* eol = std::memchr(pos_, '\n', end_ - pos_);
+        if(!close || (eol && eol < close))
+            return false;
+        value = std::string_view(pos_, static_cast<char*>(close) - pos_);
+        pos_ = static_cast<char*>(close) + 1;
+        return true;
+    }
+    if(pos_ != end_ && *pos_ == '"') {
+        char* out = begin;
+        for(++pos_; pos_ != end_ && *pos_ != '"'; ++pos_) {
+            char c = *pos_;
+            if(c == '\n')
+                return false;
+            if(c == '\\') {
+                if(++pos_ == end_)
+                    return false;
+                switch(*pos_) {
+                case 'n':
+                    c = '\n';
+                    break;
+                case 't':
+                    c = '\t';
+                    break;
+                case 'r':
+                    c = '\r';
+                    break;
+                default:
+                    c = *pos_;
+                }
+            }
+            *out++ = c;
+        }
+        if(pos_ == end_)
+            return false;
+        ++pos_;
+        value = std::string_view(begin, out - begin);
+        return true;
+    }
+    // Bare value, inside an array it also ends at ',' and ']'.
+    char* last = pos_;
+    for(; pos_ != end_ && *pos_ != '\n'; ++pos_) {
+        char c = *pos_;
+        if(inArray_ && (c == ',' || c == ']'))
+            break;
+        if(c == '#' && (pos_ == begin || pos_[-1] == ' ' || pos_[-1] == '\t'))
+            break;
+        if(c != ' ' && c != '\t' && c != '\r')
+            last = pos_ + 1;
+    }
+    value = std::string_view(begin, last - begin);
+    return true;
+}
+
+COMMAND_LINE_PARSER_INLINE bool ConfigReader::next(
+    std::string_view& key, std::string_view& value) {
+    while(!failed_) {
+        skipBlanks();
+        if(pos_ == end_)
+            return inArray_ ? fail() : false;
+        char c = *pos_;
+        if(c == '\n') {
+            ++pos_;
+            ++line_;
+            continue;
+        }
+        if(c == '#' || c == ';') {
+            skipLine();
+            continue;
+        }
+        if(inArray_) {
+            if(c == ']') {
+                ++pos_;
+                inArray_ = false;
+                if(!endOfLine())
+                    return fail();
+                continue;
+            }
+            // Elements and commas alternate, a trailing comma is allowed.
+            if(c == ',') {
+                if(!afterElement_)
+                    return fail();
+                ++pos_;
+                afterElement_ = false;
+                continue;
+            }
+            if(afterElement_ || !readValue(value))
+                return fail();
+            afterElement_ = true;
+            key = key_;
+            return true;
+        }
+        if(c == '[') {
+            ++pos_;
+            auto* close = std::memchr(pos_, ']', end_ - pos_);
+            auto* eol = std::memchr(pos_, '\n', end_ - pos_);
+            if(!close || (eol && eol < close))
+                return fail();
+            section_ = std::string_view(pos_, static_cast<char*>(close) - pos_);
+            while(!section_.empty() && section_.front() == ' ')
+                section_.remove_prefix(1);
+            while(!section_.empty() && section_.back() == ' ')
+                section_.remove_suffix(1);
+            pos_ = static_cast<char*>(close) + 1;
+            if(!endOfLine())
+                return fail();
+            continue;
+        }
+        char* begin = pos_;
+        char* last = pos_;
+        for(; pos_ != end_ && *pos_ != '=' && *pos_ != '\n'; ++pos_) {
+            if(*pos_ != ' ' && *pos_ != '\t' && *pos_ != '\r')
+                last = pos_ + 1;
+        }
+        if(pos_ == end_ || *pos_ != '=' || last == begin)
+            return fail();
+        key_ = std::string_view(begin, last - begin);
+        ++pos_;
+        skipBlanks();
+        if(pos_ != end_ && *pos_ == '[') {
+            ++pos_;
+            inArray_ = true;
+            afterElement_ = false;
+            continue;
+        }
+        if(!readValue(value) || !endOfLine())
+            return fail();
+        key = key_;
+        return true;
+    }
+    return false;
+}
+
+#endif
+
+template<class Options>
+std::string formatHelp(std::string_view program, const Options& options) {
     std::string result;
     result = "usage: "sv;
-    result += program_;
+    result += program;
     result += " [options]"sv;
     bool hasOptions = false;
     bool hasPositionalArgs = false;
     std::string namebuf;
     size_t maxNameLen = 0;
     size_t maxArgLen = 0;
-    for(auto& opt : options_) {
+    for(auto& opt : options) {
         namebuf.clear();
         auto nameLen = formatOptName(opt, namebuf);
         if(!opt.name.empty() || !opt.flags.empty()) {
@@ -395,7 +2476,7 @@ inline std::string CommandLineParser::getHelp() const {
         maxArgLen = 30;
     if(hasOptions) {
         result += "allowed options:\n"sv;
-        for(auto& opt : options_) {
+        for(auto& opt : options) {
             if(opt.name.empty() && opt.flags.empty())
                 continue;
             result += "  "sv;
@@ -411,7 +2492,7 @@ inline std::string CommandLineParser::getHelp() const {
     }
     if(hasPositionalArgs) {
         result += "positional arguments:\n"sv;
-        for(auto& opt : options_) {
+        for(auto& opt : options) {
             if(!opt.name.empty() || !opt.flags.empty())
                 continue;
             result += "  "sv;
@@ -428,4 +2509,166 @@ inline std::string CommandLineParser::getHelp() const {
     return result;
 }
 
+template<class Parser>
+bool parseArgv(Parser& parser, ErrorState& error, int argc, char** argv) {
+    if(argc <= 0)
+        return true;
+    parser.setProgram(programName(argv[0]));
+    return parseArgs(parser, error, std::span(argv + 1, argc - 1));
+}
+
+template<class Parser, class Args>
+bool parseArgs(Parser& parser, ErrorState& error, Args&& args) {
+    // A list option takes one value per occurrence when a positional
+    // argument or a subcommand name could follow it.
+    bool hasPosArg = parser.hasPosArg();
+    if constexpr(requires { parser.hasCommands(); })
+        hasPosArg = hasPosArg || parser.hasCommands();
+    bool skipUnknown = std::as_const(parser).skipUnknown();
+    // Position of the current argument, argv[0] would be 0.
+    int argNum = 0;
+    std::string_view argValue;
+    auto parseOption = [&](auto& opt, std::string_view value) {
+        if(parser.parseOption(opt, value))
+            return true;
+        error.set(
+            ParseError::invalidValue, argNum, value, parser.infoOf(opt),
+            parser.indexOf(opt));
+        return false;
+    };
+    int position = 0;
+    decltype(parser.findOption(position)) lastOption = nullptr;
+    bool lastOptionUnknown = false;
+    auto last = std::ranges::end(args);
+    for(auto it = std::ranges::begin(args); it != last; ++it) {
+        argValue = *it;
+        ++argNum;
+        auto token = classifyArg(argValue);
+        if(token.kind == ArgKind::empty)
+            continue;
+        if(token.kind == ArgKind::positional) {
+            auto arg = token.value;
+            if(lastOptionUnknown) {
+                lastOptionUnknown = false;
+                continue;
+            }
+            if(lastOption) {
+                if(!parseOption(*lastOption, arg))
+                    return false;
+                if(lastOption->type != OptionType::list || hasPosArg)
+                    lastOption = nullptr;
+            }
+            else {
+                if constexpr(requires { parser.findCommand(arg); }) {
+                    // The first positional argument names the subcommand.
+                    if(position == 0 && parser.hasCommands()) {
+                        auto command = parser.findCommand(arg);
+                        if(!command) {
+                            error.set(
+                                ParseError::unknownCommand, argNum, argValue);
+                            return false;
+                        }
+                        return parser.parseCommand(
+                            *command, argNum, std::next(it), last);
+                    }
+                }
+                ++position;
+                auto option = parser.findOption(position);
+                if(!option) {
+                    error.set(
+                        ParseError::positionalNotAllowed, argNum, argValue);
+                    return false;
+                }
+                if(!parseOption(*option, arg))
+                    return false;
+            }
+            continue;
+        }
+        lastOption = nullptr;
+        lastOptionUnknown = false;
+        if(token.kind == ArgKind::dashes)
+            continue;
+        auto name = token.name;
+        auto value = token.value;
+        bool hasValue = token.hasValue;
+        if(hasValue && name.empty()) {
+            error.set(ParseError::missingName, argNum, argValue);
+            return false;
+        }
+        bool isName = token.kind == ArgKind::longName;
+        decltype(lastOption) option = nullptr;
+        if(isName)
+            option = parser.findOption(name);
+        else if(token.kind == ArgKind::shortName)
+            option = parser.findOption(name[0]);
+        else {
+            if(hasValue) {
+                error.set(ParseError::flagValueMix, argNum, argValue);
+                return false;
+            }
+            if(parser.isFlagCluster(name)) {
+                for(auto optChar : name)
+                    parser.setFlag(*parser.findOption(optChar));
+                continue;
+            }
+            for(auto& optChar : name) {
+                option = parser.findOption(optChar);
+                if(!option) {
+                    if(skipUnknown)
+                        continue;
+                    error.set(
+                        ParseError::unknownFlag, argNum,
+                        std::string_view(&optChar, 1));
+                    return false;
+                }
+                if(option->type != OptionType::flag) {
+                    error.set(
+                        ParseError::valueRequired, argNum,
+                        std::string_view(&optChar, 1), parser.infoOf(*option),
+                        parser.indexOf(*option));
+                    return false;
+                }
+                parser.setFlag(*option);
+            }
+            continue;
+        }
+        if(!option) {
+            if(skipUnknown) {
+                lastOptionUnknown = true;
+                continue;
+            }
+            error.set(
+                isName ? ParseError::unknownOption : ParseError::unknownFlag,
+                argNum, name);
+            return false;
+        }
+        if(option->type == OptionType::flag) {
+            if(hasValue) {
+                error.set(
+                    ParseError::valueUnexpected, argNum, argValue,
+                    parser.infoOf(*option), parser.indexOf(*option));
+                return false;
+            }
+            parser.setFlag(*option);
+            continue;
+        }
+        if(!hasValue) {
+            lastOption = option;
+            continue;
+        }
+        if(!parseOption(*option, value))
+            return false;
+        if(option->type == OptionType::list && !hasPosArg)
+            lastOption = option;
+    }
+    if(!lastOption || parser.isParsed(*lastOption))
+        return true;
+    error.set(
+        ParseError::valueRequired, argNum, argValue,
+        parser.infoOf(*lastOption), parser.indexOf(*lastOption));
+    return false;
+}
+
+} // namespace detail
+
 } // namespace univang
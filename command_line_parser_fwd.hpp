@@ -0,0 +1,16 @@
+#pragma once
+#include <cstdint>
+
+// Declarations of the public types of command_line_parser.hpp, for headers
+// that only pass parsers, schemas or parse states by reference.
+namespace univang {
+
+struct OptionSpec;
+enum class ParseError : uint8_t;
+struct ParseErrorInfo;
+class ParseState;
+class CommandLineParser;
+template<class Target>
+class CommandLineSchema;
+
+} // namespace univang
@@ -0,0 +1,780 @@
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <ranges>
+
+#include "static_command_line_parser.hpp"
+
+using namespace univang;
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const char* expr, int line) {
+    if(ok)
+        return;
+    std::cerr << __FILE__ << ':' << line << ": check failed: " << expr
+              << '\n';
+    ++failures;
+}
+#define CHECK(expr) check((expr), #expr, __LINE__)
+
+using Args = std::vector<const char*>;
+
+char** argvOf(Args& args) {
+    return const_cast<char**>(args.data());
+}
+int argcOf(const Args& args) {
+    return static_cast<int>(args.size());
+}
+
+std::string tempPath(std::string_view name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+// Writes text to a file in the temporary directory, returns its path.
+std::string writeFile(std::string_view name, std::string_view text) {
+    auto path = tempPath(name);
+    std::ofstream(path, std::ios::binary) << text;
+    return path;
+}
+
+// True if make() is a constant expression, false if it throws while being
+// evaluated at compile time.
+template<auto make>
+constexpr bool isConstant =
+    requires { typename std::bool_constant<(make(), true)>; };
+
+constexpr bool rejects(std::string_view spec, std::string_view reason) {
+    auto* result = OptionSpec::check(spec);
+    return result && result == reason;
+}
+
+void testSpecs() {
+    constexpr OptionSpec specs[] = {"help,h"_spec, "+level,l,n"_spec};
+    static_assert(uniqueSpecs(specs));
+    static_assert(!specs[0].required && specs[0].flags == "h");
+    static_assert(specs[1].required && specs[1].name == "level");
+    static_assert(specs[1].flags == "l" && specs[1].hint == "n");
+    constexpr auto path = "+,,path"_spec;
+    static_assert(path.required && path.name.empty() && path.hint == "path");
+
+    for(auto spec : {"help", "help,h", "+level,l,n", ",,path", "a,xyz"})
+        CHECK(!OptionSpec::check(spec));
+    constexpr auto spaces = "spaces and control characters not allowed";
+    static_assert(rejects("a b", spaces) && rejects("a,\t", spaces));
+    static_assert(rejects("a,b,c,d", "too many fields"));
+    static_assert(rejects("a,", "empty trailing field"));
+    static_assert(rejects("a,b,", "empty trailing field"));
+    static_assert(rejects("-a", "option name starts with '-' or '+'"));
+    static_assert(rejects("++a", "option name starts with '-' or '+'"));
+    static_assert(rejects("a=b", "option name contains '='"));
+    static_assert(rejects("a,-", "invalid flag character"));
+    static_assert(rejects("a,xx", "duplicate flag"));
+
+    // The literal and uniqueSpecs() fail to compile on bad specs.
+    static_assert(isConstant<[]() consteval { return "a,x"_spec; }>);
+    static_assert(!isConstant<[]() consteval { return "a b"_spec; }>);
+    static_assert(!isConstant<[]() consteval { return "a,xx"_spec; }>);
+    static_assert(!isConstant<[]() consteval { return "a,b,c,d"_spec; }>);
+    static_assert(!isConstant<[]() consteval {
+        OptionSpec names[] = {"a,x"_spec, "a,y"_spec};
+        return uniqueSpecs(names);
+    }>);
+    static_assert(!isConstant<[]() consteval {
+        OptionSpec flags[] = {"a,xy"_spec, "b,zy"_spec};
+        return uniqueSpecs(flags);
+    }>);
+    static_assert(isConstant<[]() consteval {
+        OptionSpec positional[] = {",,a"_spec, ",,b"_spec, "c,x"_spec};
+        return uniqueSpecs(positional);
+    }>);
+
+    bool help = false;
+    int level = 0;
+    CommandLineParser parser;
+    parser.addFlag(help, specs[0]).add(level, specs[1]);
+    Args args{"prog", "-h", "--level", "3"};
+    CHECK(parser.parse(argcOf(args), argvOf(args)));
+    CHECK(help && level == 3 && parser.checkRequired());
+}
+
+// Same schema as a StaticParser and a CommandLineParser.
+using Static = StaticParser<
+    Opt<"help,h", bool, "print help">,
+    Opt<"+compression,c,level", std::optional<int>, "compression level">,
+    Opt<"name,n", std::string_view, "name">,
+    Opt<"define,D", std::vector<int>, "numbers">,
+    Opt<"verbose,v", bool>,
+    Opt<"+,,path", std::vector<std::string_view>, "file path(s)", -1>>;
+
+struct Dynamic {
+    bool help = false;
+    std::optional<int> compression;
+    std::string_view name;
+    std::vector<int> define;
+    bool verbose = false;
+    std::vector<std::string_view> paths;
+    CommandLineParser parser;
+
+    Dynamic() {
+        parser.addFlag(help, "help,h", "print help")
+            .add(compression, "+compression,c,level", "compression level")
+            .add(name, "name,n", "name")
+            .add(define, "define,D", "numbers")
+            .addFlag(verbose, "verbose,v")
+            .add(paths, "+,,path", "file path(s)", -1);
+    }
+};
+
+void compare(Static& s, Dynamic& d, Args args) {
+    bool sOk = s.parse(argcOf(args), argvOf(args));
+    bool dOk = d.parser.parse(argcOf(args), argvOf(args));
+    CHECK(sOk == dOk);
+    if(sOk && dOk) {
+        sOk = s.checkRequired();
+        dOk = d.parser.checkRequired();
+        CHECK(sOk == dOk);
+    }
+    CHECK(s.error() == d.parser.error());
+    CHECK(s.errorInfo().code == d.parser.errorInfo().code);
+    CHECK(s.errorInfo().argIndex == d.parser.errorInfo().argIndex);
+    CHECK(s.errorInfo().option == d.parser.errorInfo().option);
+    CHECK(s.get<"help">() == d.help);
+    CHECK(s.get<"compression">() == d.compression);
+    CHECK(s.get<"name">() == d.name);
+    CHECK(s.get<"define">() == d.define);
+    CHECK(s.get<"verbose">() == d.verbose);
+    CHECK(s.get<"path">() == d.paths);
+    CHECK(s.getHelp() == d.parser.getHelp());
+}
+
+void testStaticParser() {
+    const Args cases[] = {
+        {"prog", "-c", "5", "a", "b"},
+        {"prog", "--compression=7", "--name", "x", "a"},
+        {"prog", "-hv", "-c3", "a"},
+        {"prog", "-D", "1", "-D2", "--define=3", "-n", "y", "a"},
+        {"prog", "-D", "1", "-D", "x", "a"},
+        {"prog", "--define=1", "--define=", "a"},
+        {"prog", "--", "-c", "5"},
+        {"prog", "--help"},
+        {"prog", "--bogus", "a"},
+        {"prog", "-x", "a"},
+        {"prog", "a", "-c"},
+        {"prog", "-c", "five", "a"},
+        {"prog", "-hc", "5"},
+        {"prog", "--help=yes"},
+        {"prog", "-", "a"},
+    };
+    for(auto& args : cases) {
+        Static s;
+        Dynamic d;
+        compare(s, d, args);
+    }
+    // One parser of each kind for all command lines, reset in between.
+    Static s;
+    Dynamic d;
+    for(auto& args : cases) {
+        s.reset();
+        d.parser.reset();
+        compare(s, d, args);
+    }
+    s.reset();
+    d.parser.reset();
+    CHECK(s.get<"path">().empty() && !s.get<"help">());
+
+    s.setProgram("tool");
+    d.parser.setProgram("tool");
+    CHECK(s.getHelp() == d.parser.getHelp());
+    s.skipUnknown();
+    d.parser.skipUnknown();
+    compare(s, d, {"prog", "--bogus", "-x", "-c", "1", "a"});
+    std::vector<std::string> strings{"--name", "z", "-c", "2", "p"};
+    CHECK(s.parse(strings) && d.parser.parse(strings));
+    CHECK(s.get<"name">() == "z" && d.name == "z");
+    CHECK(s.get<1>() == 2 && d.compression == 2);
+}
+
+void testPerfectHash() {
+    static constexpr std::array<std::string_view, 13> names{
+        "help", "compression", "name", "define", "verbose", "output",
+        "jobs", "j", "level", "quiet", "threads", "a-much-longer-name", ""};
+    static constexpr auto table = detail::makePerfectHash<
+        detail::perfectHashSlots<names.size()>,
+        detail::perfectHashBuckets<names.size()>>(names);
+    // Empty keys are left out.
+    for(size_t i = 0; i + 1 < names.size(); ++i)
+        CHECK(table.find(names[i]) == i + 1);
+    for(auto name : {"", "hel", "helpx", "x", "compressio", "Help"}) {
+        auto index = table.find(name);
+        CHECK(!index || names[index - 1] != name);
+    }
+}
+
+void testMultiCall() {
+    using Tool = MultiCall<"ls", "cat", "head", "tail">;
+    static_assert(Tool::find("head") == 2 && Tool::find("hea") == -1);
+    bool all = false;
+    int lines = 0;
+    int built = 0;
+    auto ls = [&](CommandLineParser& p) {
+        ++built;
+        p.addFlag(all, "all,a", "show hidden files");
+    };
+    auto head = [&](CommandLineParser& p) {
+        ++built;
+        p.add(lines, "lines,n", "line count");
+    };
+    Tool tool;
+    tool.add<"ls">(ls).add<"head">(head);
+
+    Args args{"/bin/ls", "-a"};
+    CHECK(tool.parse(argcOf(args), argvOf(args)));
+    CHECK(tool.applet() == "ls" && all && built == 1);
+    CommandLineParser direct;
+    ls(direct);
+    CHECK(direct.parse(argcOf(args), argvOf(args)));
+    CHECK(tool.parser()->getHelp() == direct.getHelp());
+
+    args = {"./box", "head", "-n", "5"};
+    CHECK(tool.parse(argcOf(args), argvOf(args)));
+    CHECK(tool.applet() == "head" && lines == 5 && built == 3);
+    args = {"/usr/bin/head", "-n", "7"};
+    CHECK(tool.parse(argcOf(args), argvOf(args)));
+    CHECK(lines == 7 && built == 3);
+    args = {"head", "-x"};
+    CHECK(!tool.parse(argcOf(args), argvOf(args)));
+    CHECK(tool.errorInfo().code == ParseError::unknownFlag);
+    CHECK(tool.error() == "unknown option: -x");
+    CHECK(tool.errorInfo().argIndex == 1);
+    args = {"./box", "head", "-n", "1", "-x"};
+    CHECK(!tool.parse(argcOf(args), argvOf(args)));
+    CHECK(tool.errorInfo().argIndex == 4);
+    args = {"cat"};
+    CHECK(!tool.parse(argcOf(args), argvOf(args)));
+    CHECK(tool.errorInfo().code == ParseError::unknownCommand);
+    CHECK(tool.applet().empty() && !tool.parser());
+    args = {"./box", "rm"};
+    CHECK(!tool.parse(argcOf(args), argvOf(args)));
+    CHECK(tool.error() == "unknown command: rm");
+    CHECK(tool.errorInfo().argIndex == 1);
+    args = {"./box"};
+    CHECK(!tool.parse(argcOf(args), argvOf(args)));
+    CHECK(tool.error() == "unknown command: box");
+    CHECK(tool.errorInfo().argIndex == 0);
+}
+
+struct Files {
+    int level = 0;
+    std::string_view name;
+    std::vector<std::string_view> paths;
+    CommandLineParser parser;
+
+    Files() {
+        parser.add(level, "level,l")
+            .add(name, "name")
+            .add(paths, ",,path", "", -1)
+            .responseFiles();
+    }
+};
+
+void testResponseFiles() {
+    auto nested = writeFile(
+        "command_line_parser_test_nested.rsp", "--name 'in nested' n1\n");
+    auto top = writeFile(
+        "command_line_parser_test_top.rsp",
+        "# comment\n-l 5 \"a b\" c\\ d @" + nested + " t1\n");
+    auto loop = tempPath("command_line_parser_test_loop.rsp");
+    writeFile("command_line_parser_test_loop.rsp", "x @" + loop);
+    auto bad = writeFile("command_line_parser_test_bad.rsp", "'open");
+    auto topArg = "@" + top;
+
+    Files f;
+    Args args{"prog", topArg.c_str(), "z"};
+    CHECK(f.parser.parse(argcOf(args), argvOf(args)));
+    CHECK(f.level == 5 && f.name == "in nested");
+    CHECK((f.paths == std::vector<std::string_view>{
+                          "a b", "c d", "n1", "t1", "z"}));
+
+    Files off;
+    off.parser.responseFiles(false);
+    CHECK(off.parser.parse(argcOf(args), argvOf(args)));
+    CHECK(off.paths.size() == 2 && off.paths[0] == topArg);
+
+    auto missing = "@" + top + ".missing";
+    Files m;
+    args = {"prog", "a", missing.c_str()};
+    CHECK(!m.parser.parse(argcOf(args), argvOf(args)));
+    CHECK(m.parser.errorInfo().code == ParseError::responseFileUnreadable);
+    CHECK(m.parser.errorInfo().argIndex == 2);
+
+    auto loopArg = "@" + loop;
+    Files l;
+    args = {"prog", loopArg.c_str()};
+    CHECK(!l.parser.parse(argcOf(args), argvOf(args)));
+    CHECK(l.parser.errorInfo().code == ParseError::responseFileNesting);
+
+    auto badArg = "@" + bad;
+    Files b;
+    args = {"prog", badArg.c_str()};
+    CHECK(!b.parser.parse(argcOf(args), argvOf(args)));
+    CHECK(b.parser.errorInfo().code == ParseError::unterminatedQuote);
+
+    // Values stay valid until reset().
+    Files r;
+    args = {"prog", topArg.c_str()};
+    CHECK(r.parser.parse(argcOf(args), argvOf(args)));
+    CHECK(r.parser.parse(argcOf(args), argvOf(args)));
+    CHECK(r.name == "in nested" && r.paths.size() == 8);
+    r.parser.reset();
+    CHECK(r.paths.empty());
+}
+
+struct Config {
+    int level = 0;
+    int jobs = 0;
+    bool help = false;
+    std::string_view name;
+    std::string_view opt;
+    std::vector<std::string_view> tags;
+    CommandLineParser parser;
+
+    Config() {
+        parser.add(level, "+level,l")
+            .add(name, "name")
+            .addFlag(help, "help")
+            .add(jobs, "build.jobs")
+            .add(tags, "build.tags")
+            .add(opt, "deep.sub.opt");
+    }
+};
+
+void testParseFile() {
+    auto good = writeFile(
+        "command_line_parser_test_good.ini",
+        "; comment\n"
+        "level = 3\n"
+        "name = \"quoted \\\"name\\\"\\n\"\n"
+        "help = true\n"
+        "[build]\n"
+        "jobs = 8 # trailing comment\n"
+        "tags = [a, 'b c',\n  \"d\"]\n"
+        "tags = e\n"
+        "[deep.sub]\n"
+        "opt = 'single # kept'\n");
+    Config c;
+    CHECK(c.parser.parseFile(good) && c.parser.checkRequired());
+    CHECK(c.level == 3 && c.name == "quoted \"name\"\n" && c.help);
+    CHECK(c.jobs == 8 && c.opt == "single # kept");
+    CHECK((c.tags == std::vector<std::string_view>{"a", "b c", "d", "e"}));
+
+    // Scalars given on the command line override the file, list values are
+    // appended.
+    Config o;
+    Args args{"prog", "--level", "9", "--build.tags", "f"};
+    CHECK(o.parser.parseFile(good));
+    CHECK(o.parser.parse(argcOf(args), argvOf(args)));
+    CHECK(o.level == 9 && o.jobs == 8);
+    CHECK((o.tags == std::vector<std::string_view>{"a", "b c", "d", "e", "f"}));
+
+    Config u;
+    auto unknown = writeFile(
+        "command_line_parser_test_unknown.ini", "level = 1\n[x]\ny = 2\n");
+    CHECK(!u.parser.parseFile(unknown));
+    CHECK(u.parser.errorInfo().code == ParseError::unknownOption);
+    CHECK(u.parser.errorInfo().argIndex == 3);
+    CHECK(u.parser.error() == "unknown option: --x.y");
+
+    Config s;
+    auto syntax = writeFile(
+        "command_line_parser_test_syntax.ini", "level = 1\n\nname\n");
+    CHECK(!s.parser.parseFile(syntax));
+    CHECK(s.parser.errorInfo().code == ParseError::configFileSyntax);
+    CHECK(s.parser.errorInfo().argIndex == 3);
+    CHECK(s.parser.error() == "invalid config file syntax: " + syntax + ":3");
+
+    // Quoted values cut off by the end of the file, also right after a
+    // backslash, are syntax errors.
+    for(auto text : {"name = \"abc\\", "name = \"abc", "name = 'abc"}) {
+        Config e;
+        auto eof = writeFile("command_line_parser_test_eof.ini", text);
+        CHECK(!e.parser.parseFile(eof));
+        CHECK(e.parser.errorInfo().code == ParseError::configFileSyntax);
+        CHECK(e.parser.errorInfo().argIndex == 1);
+    }
+
+    Config i;
+    auto invalid = writeFile(
+        "command_line_parser_test_invalid.ini", "[build]\njobs = many\n");
+    CHECK(!i.parser.parseFile(invalid));
+    CHECK(i.parser.errorInfo().code == ParseError::invalidValue);
+    CHECK(i.parser.errorInfo().argIndex == 2);
+
+    Config f;
+    auto flag = writeFile(
+        "command_line_parser_test_flag.ini", "level = 1\nhelp = 1\n");
+    CHECK(f.parser.parseFile(flag) && f.help);
+
+    Config m;
+    CHECK(!m.parser.parseFile(good + ".missing"));
+    CHECK(m.parser.errorInfo().code == ParseError::configFileUnreadable);
+
+    Config r;
+    auto empty = writeFile("command_line_parser_test_empty.ini", "");
+    CHECK(r.parser.parseFile(empty) && !r.parser.checkRequired());
+    CHECK(r.parser.errorInfo().code == ParseError::requiredMissing);
+}
+
+struct Env {
+    int level = 0;
+    int jobs = 0;
+    bool help = false;
+    std::vector<std::string_view> tags;
+    CommandLineParser parser;
+
+    Env() {
+        parser.add(level, "+level,l")
+            .envPrefix("MYTOOL_")
+            .addFlag(help, "help")
+            .add(jobs, "build.jobs")
+            .add(tags, "build-tags");
+    }
+    bool parse(Args args, Args env) {
+        env.push_back(nullptr);
+        return parser.parse(argcOf(args), argvOf(args))
+               && parser.parseEnv(const_cast<char**>(env.data()))
+               && parser.checkRequired();
+    }
+};
+
+void testParseEnv() {
+    Env e;
+    CHECK(e.parse(
+        {"prog"},
+        {"PATH=/bin", "MYTOOL_LEVEL=4", "MYTOOL_HELP=true",
+         "MYTOOL_BUILD_JOBS=3", "MYTOOL_BUILD_TAGS=x", "mytool_level=9",
+         "MYTOOL_level=8", "MYTOOL_=1", "MYTOOL_UNKNOWN=2"}));
+    CHECK(e.level == 4 && e.help && e.jobs == 3);
+    CHECK((e.tags == std::vector<std::string_view>{"x"}));
+
+    // The command line wins over the environment.
+    Env c;
+    CHECK(c.parse(
+        {"prog", "--level", "1", "--build-tags", "y"},
+        {"MYTOOL_LEVEL=4", "MYTOOL_BUILD_TAGS=x"}));
+    CHECK(c.level == 1 && (c.tags == std::vector<std::string_view>{"y"}));
+
+    // Flags take true, false, 1 or 0, an empty variable leaves them unset.
+    Env f;
+    CHECK(f.parse({"prog"}, {"MYTOOL_LEVEL=1", "MYTOOL_HELP="}) && !f.help);
+    Env t;
+    CHECK(t.parse({"prog"}, {"MYTOOL_LEVEL=1", "MYTOOL_HELP=1"}) && t.help);
+    for(auto entry : {"MYTOOL_HELP=0", "MYTOOL_HELP=false"}) {
+        Env n;
+        n.help = true;
+        CHECK(n.parse({"prog"}, {"MYTOOL_LEVEL=1", entry}) && !n.help);
+    }
+    Env y;
+    CHECK(!y.parse({"prog"}, {"MYTOOL_LEVEL=1", "MYTOOL_HELP=yes"}));
+    CHECK(y.parser.errorInfo().code == ParseError::invalidEnvValue);
+
+    Env i;
+    CHECK(!i.parse({"prog"}, {"MYTOOL_LEVEL=abc"}));
+    CHECK(i.parser.errorInfo().code == ParseError::invalidEnvValue);
+    CHECK(i.parser.error()
+          == "invalid environment variable value: MYTOOL_LEVEL=abc");
+
+    Env r;
+    CHECK(!r.parse({"prog"}, {}));
+    CHECK(r.parser.errorInfo().code == ParseError::requiredMissing);
+}
+
+void testCommandLineString() {
+    Files f;
+    f.parser.setProgram("tool");
+    std::string_view cmdline =
+        "  --level 5 --name='a b' plain another\\ one \"dq \\$x \\a\""
+        " # comment\n tail";
+    CHECK(f.parser.parse(cmdline));
+    CHECK(f.level == 5 && f.name == "a b");
+    CHECK((f.paths == std::vector<std::string_view>{
+                          "plain", "another one", "dq $x \\a", "tail"}));
+    // Plain words are views of the command line.
+    CHECK(f.paths[0].data() == cmdline.data() + cmdline.find("plain"));
+
+    Files e;
+    CHECK(e.parser.parse(""sv) && e.paths.empty());
+
+    Files q;
+    CHECK(!q.parser.parse("a 'unterminated"sv));
+    CHECK(q.parser.errorInfo().code == ParseError::unterminatedCommandQuote);
+    CHECK(q.parser.errorInfo().arg == "'unterminated");
+
+    Files l;
+    std::string big;
+    for(int i = 0; i < 1000; ++i)
+        big += "file" + std::to_string(i) + ' ';
+    CHECK(l.parser.parse(big) && l.paths.size() == 1000);
+    CHECK(l.paths[999] == "file999");
+}
+
+void testArgRanges() {
+    using Strings = std::vector<std::string>;
+    using Views = std::vector<std::string_view>;
+    Strings strings{"-c", "5", "--name", "x", "a"};
+    auto copies = std::views::transform(
+        strings, [](const std::string& s) { return s; });
+    auto views = std::views::transform(
+        strings, [](const std::string& s) { return std::string_view(s); });
+    static_assert(detail::ArgRange<Strings&>);
+    static_assert(detail::ArgRange<const Strings&>);
+    static_assert(detail::ArgRange<std::span<const std::string>>);
+    static_assert(detail::ArgRange<Views>);
+    static_assert(detail::ArgRange<std::vector<const char*>>);
+    static_assert(detail::ArgRange<decltype(views)>);
+    static_assert(detail::ArgRange<decltype(strings | std::views::drop(1))>);
+    // Values would point into strings destroyed after the parse.
+    static_assert(!detail::ArgRange<Strings>);
+    static_assert(!detail::ArgRange<decltype(copies)>);
+    static_assert(!detail::ArgRange<std::string>);
+    static_assert(!detail::ArgRange<const char*>);
+
+    Dynamic d;
+    CHECK(d.parser.parse(std::span<const std::string>(strings)));
+    CHECK(d.compression == 5 && d.name == "x");
+    CHECK(d.name.data() == strings[3].data());
+    d.parser.reset();
+    CHECK(d.parser.parse(Views{"-c", "6", "b"}) && d.compression == 6);
+    d.parser.reset();
+    auto notShort = [](const std::string& s) { return s != "-c"; };
+    CHECK(d.parser.parse(strings | std::views::filter(notShort)));
+    CHECK(d.name == "x" && (d.paths == Views{"5", "a"}));
+
+    // A subcommand parses the rest of a range of owned strings.
+    bool force = false;
+    std::string_view file;
+    CommandLineParser tool;
+    tool.addCommand("run", [&](CommandLineParser& p) {
+        p.addFlag(force, "force,f").add(file, "+,,file", "", 1);
+    });
+    Strings args{"run", "-f", "input"};
+    CHECK(tool.parse(args) && force && file == "input");
+    CHECK(file.data() == args[2].data());
+}
+
+void testErrorLifetime() {
+    // Errors keep a copy of the text they refer to.
+    Dynamic d;
+    CHECK(!d.parser.parse(std::string("a --bogus")));
+    CHECK(d.parser.errorInfo().arg == "bogus");
+    CHECK(d.parser.error() == "unknown option: --bogus");
+    {
+        std::vector<std::string> args{"-c", std::string(300, '7')};
+        CHECK(!d.parser.parse(args));
+    }
+    CHECK(d.parser.errorInfo().code == ParseError::invalidValue);
+    CHECK(d.parser.errorInfo().arg == std::string(256, '7'));
+    char text[16];
+    CHECK(d.parser.formatError(text, sizeof(text)) == 15);
+    CHECK(std::string_view(text) == "invalid option ");
+
+    // Errors of a subcommand are copied to the parent parser.
+    int jobs = 0;
+    CommandLineParser tool;
+    tool.addCommand("build", [&](CommandLineParser& p) {
+        p.add(jobs, "+jobs,j");
+    });
+    {
+        std::vector<std::string> args{"build", "-j", "x"};
+        CHECK(!tool.parse(args));
+    }
+    CHECK(tool.error() == "invalid option value: x");
+    CHECK(tool.errorInfo().argIndex == 3);
+    tool.reset();
+    {
+        std::vector<std::string> args{"build"};
+        CHECK(tool.parse(args) && !tool.checkRequired());
+    }
+    CHECK(tool.error() == "required option missing: -j [ --jobs ] arg");
+    Static s;
+    Args args{"prog", "-c", "1", "-"};
+    CHECK(s.parse(argcOf(args), argvOf(args)));
+    CHECK(!s.checkRequired());
+    CHECK(s.error() == "required option missing: path");
+}
+
+void testCopy() {
+    static_assert(std::is_copy_constructible_v<CommandLineParser>);
+    static_assert(std::is_copy_assignable_v<CommandLineParser>);
+    static_assert(std::is_copy_constructible_v<ParseState>);
+    int level = 0;
+    int jobs = 0;
+    int built = 0;
+    CommandLineParser tool;
+    tool.setProgram("tool").add(level, "level,l", "level");
+    tool.addCommand("build", [&](CommandLineParser& p) {
+        ++built;
+        p.add(jobs, "+jobs,j");
+    });
+
+    // Copies bind the same variables and have the same help.
+    CommandLineParser copy = tool;
+    Args args{"tool", "-l", "3"};
+    CHECK(copy.parse(argcOf(args), argvOf(args)) && level == 3);
+    CHECK(copy.getHelp() == tool.getHelp());
+
+    // Built subcommand parsers stay with the original.
+    args = {"tool", "build", "-j", "4"};
+    CHECK(tool.parse(argcOf(args), argvOf(args)));
+    CHECK(tool.command() == "build" && jobs == 4 && built == 1);
+    CommandLineParser second(tool);
+    CHECK(second.command().empty() && !second.commandParser());
+    args = {"tool", "build", "-j", "5"};
+    CHECK(second.parse(argcOf(args), argvOf(args)));
+    CHECK(second.command() == "build" && jobs == 5 && built == 2);
+    CHECK(tool.commandParser() != second.commandParser());
+
+    // Errors are copied with their text.
+    args = {"tool", "build", "-j", "x"};
+    CHECK(!second.parse(argcOf(args), argvOf(args)));
+    copy = second;
+    second.reset();
+    CHECK(copy.error() == "invalid option value: x");
+    CHECK(copy.errorInfo().argIndex == 3);
+    CHECK(second.error().empty());
+    CommandLineParser moved = std::move(copy);
+    CHECK(moved.error() == "invalid option value: x");
+}
+
+void testCommands() {
+    std::vector<std::string_view> includes;
+    int jobs = 0;
+    CommandLineParser tool;
+    tool.setProgram("tool").add(includes, "include,I", "include paths");
+    tool.addCommand("build", [&](CommandLineParser& p) {
+        p.add(jobs, "jobs,j");
+    });
+
+    // A list option before the command takes one value per occurrence.
+    Args args{"tool", "-I", "a", "build", "-j", "8"};
+    CHECK(tool.parse(argcOf(args), argvOf(args)));
+    CHECK(tool.command() == "build" && jobs == 8);
+    CHECK((includes == std::vector<std::string_view>{"a"}));
+    tool.reset();
+    args = {"tool", "-I", "a", "-I", "b", "build"};
+    CHECK(tool.parse(argcOf(args), argvOf(args)));
+    CHECK(includes.size() == 2 && tool.command() == "build");
+    tool.reset();
+    args = {"tool", "-I", "a", "b", "build"};
+    CHECK(!tool.parse(argcOf(args), argvOf(args)));
+    CHECK(tool.error() == "unknown command: b");
+
+    // Adding commands after a parse keeps the help of a built one valid.
+    tool.reset();
+    args = {"tool", "build", "-j", "2"};
+    CHECK(tool.parse(argcOf(args), argvOf(args)));
+    auto* build = tool.commandParser();
+    for(auto name : {"a", "b", "c", "d", "e", "f", "g", "h", "i"})
+        tool.addCommand(name, [](CommandLineParser&) {});
+    CHECK(build->getHelp().starts_with("usage: tool build"));
+}
+
+// Value of text as converted for an option of type T, nullopt if rejected.
+template<class T>
+std::optional<T> convert(std::string_view text) {
+    T value{};
+    if(!detail::valueParser<T>()(&value, text, sizeof(T)))
+        return std::nullopt;
+    return value;
+}
+template<class T>
+std::optional<T> fromChars(std::string_view text) {
+    T value{};
+    auto end = text.data() + text.size();
+    auto res = std::from_chars(text.data(), end, value);
+    if(res.ec != std::errc{} || res.ptr != end)
+        return std::nullopt;
+    return value;
+}
+
+void testIntegers() {
+    // Around the digit blocks of the kernels and the limits of each type.
+    const std::string_view texts[] = {
+        "", "-", "+", "+5", "-+5", "--5", " 5", "5 ", "0", "-0", "00",
+        "7", "1234", "12345", "1234567", "12345678", "123456789",
+        "1234567a", "12345678a", "a2345678", "123456781234567",
+        "1234567812345678", "12345678123456789", "1234567890123456789",
+        "12345678901234567890", "123456789012345678901",
+        "127", "128", "-128", "-129", "255", "256",
+        "32767", "32768", "-32768", "-32769", "65535", "65536",
+        "2147483647", "2147483648", "-2147483648", "-2147483649",
+        "4294967295", "4294967296",
+        "9223372036854775807", "9223372036854775808",
+        "-9223372036854775808", "-9223372036854775809",
+        "18446744073709551615", "18446744073709551616",
+        "18446744073709551619", "18446744073709551620",
+        "28446744073709551615", "99999999999999999999",
+        "-18446744073709551615", "000000000000000000001",
+        "00000000000000000018446744073709551615",
+        "-00000000000000000009223372036854775808",
+        "-00000000000000000009223372036854775809"};
+    for(auto text : texts) {
+        CHECK(convert<int8_t>(text) == fromChars<int8_t>(text));
+        CHECK(convert<int16_t>(text) == fromChars<int16_t>(text));
+        CHECK(convert<int32_t>(text) == fromChars<int32_t>(text));
+        CHECK(convert<int64_t>(text) == fromChars<int64_t>(text));
+        CHECK(convert<uint8_t>(text) == fromChars<uint8_t>(text));
+        CHECK(convert<uint16_t>(text) == fromChars<uint16_t>(text));
+        CHECK(convert<uint32_t>(text) == fromChars<uint32_t>(text));
+        CHECK(convert<uint64_t>(text) == fromChars<uint64_t>(text));
+    }
+    CHECK(convert<int64_t>("-9223372036854775808") == INT64_MIN);
+    CHECK(convert<int64_t>("9223372036854775807") == INT64_MAX);
+    CHECK(!convert<int64_t>("9223372036854775808"));
+    CHECK(convert<uint64_t>("18446744073709551615") == UINT64_MAX);
+    CHECK(!convert<uint64_t>("18446744073709551616"));
+    CHECK(!convert<uint64_t>("-1") && !convert<int>("+1"));
+    CHECK(convert<int>("-0") == 0);
+}
+
+struct Test {
+    std::string_view name;
+    void (*run)();
+};
+constexpr Test tests[] = {
+    {"specs", testSpecs},
+    {"static_parser", testStaticParser},
+    {"perfect_hash", testPerfectHash},
+    {"multi_call", testMultiCall},
+    {"response_files", testResponseFiles},
+    {"parse_file", testParseFile},
+    {"parse_env", testParseEnv},
+    {"command_line_string", testCommandLineString},
+    {"arg_ranges", testArgRanges},
+    {"error_lifetime", testErrorLifetime},
+    {"copy", testCopy},
+    {"commands", testCommands},
+    {"integers", testIntegers},
+};
+
+} // namespace
+
+// Runs the tests named by the arguments, all of them without arguments.
+int main(int argc, char** argv) {
+    bool found = argc < 2;
+    for(auto& test : tests) {
+        if(argc < 2 || std::find(argv + 1, argv + argc, test.name)
+                           != argv + argc) {
+            test.run();
+            found = true;
+        }
+    }
+    if(!found) {
+        std::cerr << "no such test\n";
+        return 1;
+    }
+    return failures ? 1 : 0;
+}
@@ -1,29 +1,97 @@
 #include <iostream>
 
+#include "allocation_counter.hpp"
 #include "command_line_parser.hpp"
 
-int main(int argc, char** argv) {
+using namespace univang;
+
+struct Options {
     bool printHelp = false;
     std::optional<int> compression;
     std::vector<std::string_view> files;
-    univang::CommandLineParser poParser;
-    poParser.addFlag(printHelp, "help,h", "print help")
-        .add(compression, "+compression,c,level", "compression level")
-        .add(files, "+,,path"sv, "file path(s)", -1);
+};
+
+// Parses the arguments again after reset(), as one command line string and
+// through a CommandLineSchema. Each must give the same result as the first
+// parse and, once the first round has reserved capacity, not allocate.
+bool checkReparse(CommandLineParser& parser, bool ok, int argc, char** argv) {
+    std::string cmdline;
+    for(int i = 1; i < argc; ++i) {
+        cmdline += argv[i];
+        cmdline += ' ';
+    }
+    CommandLineSchema<Options> schema;
+    schema.addFlag<&Options::printHelp>("help,h", "print help")
+        .add<&Options::compression>(
+            "+compression,c,level", "compression level")
+        .add<&Options::files>("+,,path"sv, "file path(s)", -1);
+    ParseState state;
+    Options target;
+    target.files.reserve(argc);
+
+    bool result = true;
+    auto check = [&](const char* what, auto parse) {
+        parse();
+        auto allocated = allocationCount();
+        bool parsed = parse();
+        if(allocationCount() != allocated) {
+            std::cerr << what << " allocated memory\n";
+            result = false;
+        }
+        if(parsed != ok) {
+            std::cerr << what << " gave another result\n";
+            result = false;
+        }
+    };
+    check("parse() after reset()", [&] {
+        parser.reset();
+        return parser.parse(argc, argv) && parser.checkRequired();
+    });
+    check("parse(cmdline)", [&] {
+        parser.reset();
+        return parser.parse(cmdline) && parser.checkRequired();
+    });
+    check("CommandLineSchema::parse()", [&] {
+        schema.reset(state, target);
+        return schema.parse(state, target, argc, argv)
+               && schema.checkRequired(state);
+    });
+    // Values must not point into cmdline.
+    parser.reset();
+    if(parser.parse(argc, argv))
+        parser.checkRequired();
+    return result;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    CommandLineParser poParser;
+    poParser.addFlag(options.printHelp, "help,h", "print help")
+        .add(options.compression, "+compression,c,level", "compression level")
+        .add(options.files, "+,,path"sv, "file path(s)", -1);
+    options.files.reserve(argc);
+    auto allocated = allocationCount();
     bool ok = poParser.parse(argc, argv);
+    bool hasRequired = ok && poParser.checkRequired();
+    if(allocationCount() != allocated) {
+        std::cerr << "parse allocated memory\n";
+        return -1;
+    }
+    if(!checkReparse(poParser, hasRequired, argc, argv))
+        return -1;
     if(!ok) {
         std::cerr << poParser.error() << '\n' << poParser.getHelp() << '\n';
         return -1;
     }
-    if(printHelp) {
+    if(options.printHelp) {
         std::cout << poParser.getHelp() << '\n';
         return 0;
     }
-    if(!poParser.checkRequired()) {
+    if(!hasRequired) {
         std::cerr << poParser.error() << '\n' << poParser.getHelp() << '\n';
         return -1;
     }
-    if(compression)
-        std::cout << "compression level is " << *compression << '\n';
+    if(options.compression)
+        std::cout << "compression level is " << *options.compression << '\n';
     return 0;
 }
@@ -0,0 +1,80 @@
+#!/bin/sh
+# Compile time and object size of a typical tool translation unit using
+# command_line_parser.hpp header-only, against the command_line_parser
+# library (COMMAND_LINE_PARSER_LIB) and with the forwarding header only.
+# Each variant is compiled RUNS times, the fastest run is reported.
+#   CXX=clang++ CXXFLAGS=-O2 RUNS=10 ./compile_bench.sh
+set -e
+
+CXX=${CXX:-c++}
+CXXFLAGS=${CXXFLAGS:--O2}
+RUNS=${RUNS:-5}
+SRC_DIR=$(cd "$(dirname "$0")" && pwd)
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+cat > "$WORK/tool.cpp" <<'CPP'
+#include "command_line_parser.hpp"
+
+#include <iostream>
+
+int main(int argc, char** argv) {
+    bool help = false;
+    int jobs = 1;
+    std::optional<int> level;
+    std::string_view output;
+    std::vector<std::string_view> files;
+    univang::CommandLineParser parser;
+    parser.addFlag(help, "help,h", "print help")
+        .add(jobs, "jobs,j,n", "parallel jobs")
+        .add(level, "+level,l,n", "compression level")
+        .add(output, "output,o,path", "output file")
+        .add(files, ",,path", "input files", -1);
+    if(!parser.parse(argc, argv) || !parser.checkRequired()) {
+        std::cerr << parser.error() << '\n' << parser.getHelp();
+        return 1;
+    }
+    return 0;
+}
+CPP
+
+cat > "$WORK/fwd.cpp" <<'CPP'
+#include "command_line_parser_fwd.hpp"
+
+void addOptions(univang::CommandLineParser& parser);
+void configure(univang::CommandLineParser& parser) {
+    addOptions(parser);
+}
+CPP
+
+now() {
+    date +%s%N
+}
+
+# compile NAME SOURCE FLAGS...
+compile() {
+    name=$1
+    source=$2
+    shift 2
+    best=
+    i=0
+    while [ $i -lt "$RUNS" ]; do
+        start=$(now)
+        $CXX -std=c++20 $CXXFLAGS "$@" -I"$SRC_DIR" -c "$source" \
+            -o "$WORK/$name.o"
+        elapsed=$(( ($(now) - start) / 1000000 ))
+        if [ -z "$best" ] || [ "$elapsed" -lt "$best" ]; then
+            best=$elapsed
+        fi
+        i=$((i + 1))
+    done
+    size=$(wc -c < "$WORK/$name.o")
+    printf '%s\t%s\t%s\n' "$name" "$best" "$size"
+}
+
+printf '# variant\tms/TU\tobject bytes\n'
+compile header-only "$WORK/tool.cpp"
+compile library "$WORK/tool.cpp" -DCOMMAND_LINE_PARSER_LIB
+compile forward "$WORK/fwd.cpp"
+# Paid once per program when the library is used.
+compile library-source "$SRC_DIR/command_line_parser.cpp"
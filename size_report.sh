@@ -0,0 +1,99 @@
+#!/bin/sh
+# Bytes of code each added option costs. Links small programs that
+# register options of one type or of many distinct types, directly and
+# through a CommandLineSchema, and prints the .text size of each program and
+# the bytes per option beyond the one option baseline.
+#   CXX=arm-linux-gnueabihf-g++ CXXFLAGS=-Os ./size_report.sh
+set -e
+
+CXX=${CXX:-c++}
+CXXFLAGS=${CXXFLAGS:--Os}
+SIZE=${SIZE:-size}
+SRC_DIR=$(cd "$(dirname "$0")" && pwd)
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+TYPES="signed_char short int long long_long unsigned_char unsigned_short
+unsigned unsigned_long unsigned_long_long float double long_double
+std::string std::string_view"
+
+# program NAME OPTIONS: OPTIONS are "kind type" lines, kind is value,
+# optional, list or member.
+program() {
+    {
+        echo '#include "command_line_parser.hpp"'
+        echo 'using signed_char = signed char;'
+        echo 'using long_long = long long;'
+        echo 'using unsigned_char = unsigned char;'
+        echo 'using unsigned_short = unsigned short;'
+        echo 'using unsigned_long = unsigned long;'
+        echo 'using unsigned_long_long = unsigned long long;'
+        echo 'using long_double = long double;'
+        echo 'struct Config {'
+        n=0
+        echo "$2" | while read -r kind type; do
+            [ "$kind" = member ] && echo "    $type m$n{};"
+            n=$((n + 1))
+        done
+        echo '};'
+        echo 'int main(int argc, char** argv) {'
+        echo '    univang::CommandLineParser parser;'
+        echo '    univang::CommandLineSchema<Config> schema;'
+        n=0
+        echo "$2" | while read -r kind type; do
+            case $kind in
+            value)
+                echo "    static $type v$n{};"
+                echo "    parser.add(v$n, \"o$n\");" ;;
+            optional)
+                echo "    static std::optional<$type> v$n;"
+                echo "    parser.add(v$n, \"o$n\");" ;;
+            list)
+                echo "    static std::vector<$type> v$n;"
+                echo "    parser.add(v$n, \"o$n\");" ;;
+            member)
+                echo "    schema.add<&Config::m$n>(\"o$n\");" ;;
+            esac
+            n=$((n + 1))
+        done
+        echo '    univang::ParseState state;'
+        echo '    Config config;'
+        echo '    return parser.parse(argc, argv)'
+        echo '        && schema.parse(state, config, argc, argv) ? 0 : 1;'
+        echo '}'
+    } > "$WORK/$1.cpp"
+    $CXX -std=c++20 $CXXFLAGS -I"$SRC_DIR" "$WORK/$1.cpp" -o "$WORK/$1"
+    $SIZE -A "$WORK/$1" | awk '$1 == ".text" { print $2 }'
+}
+
+# options KIND TYPE COUNT: COUNT options of one type, or of each type in
+# TYPES when TYPE is "each".
+options() {
+    if [ "$2" = each ]; then
+        for type in $TYPES; do
+            echo "$1 $type"
+        done
+    else
+        i=0
+        while [ $i -lt "$3" ]; do
+            echo "$1 $2"
+            i=$((i + 1))
+        done
+    fi
+}
+
+count=$(echo $TYPES | wc -w)
+printf '# options\tcount\t.text bytes\tbytes/option\n'
+for kind in value optional list member; do
+    base=$(program base "$(options $kind int 1)")
+    printf '%s int\t1\t%s\t-\n' "$kind" "$base"
+    for what in same each; do
+        if [ $what = same ]; then
+            text=$(program $kind "$(options $kind int $count)")
+        else
+            text=$(program $kind "$(options $kind each $count)")
+        fi
+        printf '%s %s\t%s\t%s\t%s\n' "$kind" "$what" "$count" "$text" \
+            $(( (text - base) / (count - 1) ))
+    done
+done
@@ -0,0 +1,493 @@
+#pragma once
+#include <bit>
+#include <tuple>
+
+#include "command_line_parser.hpp"
+
+namespace univang {
+
+namespace detail {
+
+// String literal usable as a template argument.
+template<size_t N>
+struct FixedString {
+    char data[N] = {};
+
+    consteval FixedString(const char (&str)[N]) {
+        for(size_t i = 0; i < N; ++i)
+            data[i] = str[i];
+    }
+    constexpr std::string_view view() const {
+        return {data, N - 1};
+    }
+};
+
+// Hash-and-displace perfect hash over a fixed key set. The key hash selects a
+// bucket, and the bucket displacement turns the same hash into a slot that no
+// other key occupies. A lookup costs one hash, two loads and the comparison
+// of the single candidate key by the caller.
+template<size_t SlotCount, size_t BucketCount>
+struct PerfectHash {
+    static_assert(std::has_single_bit(SlotCount));
+    uint64_t seed = 0;
+    std::array<uint32_t, BucketCount> displacements{};
+    // Key index + 1, 0 is empty.
+    std::array<uint32_t, SlotCount> slots{};
+
+    static constexpr size_t bucket(uint64_t hash) {
+        return static_cast<uint32_t>(hash >> 32) % BucketCount;
+    }
+    static constexpr size_t slot(uint64_t hash, uint32_t displacement) {
+        auto first = static_cast<uint32_t>(hash);
+        auto step =
+            static_cast<uint32_t>((hash * 0x9e3779b97f4a7c15ull) >> 32) | 1;
+        return (first + displacement * step) & (SlotCount - 1);
+    }
+    // Index + 1 of the only key that may be equal to the argument, 0 if none.
+    constexpr uint32_t find(std::string_view key) const {
+        auto hash = hashName(key, seed);
+        return slots[slot(hash, displacements[bucket(hash)])];
+    }
+};
+
+template<size_t KeyCount>
+inline constexpr size_t perfectHashSlots = std::bit_ceil(KeyCount * 2);
+template<size_t KeyCount>
+inline constexpr size_t perfectHashBuckets = KeyCount / 4 + 1;
+
+// Builds the table at compile time. Empty keys are left out, a repeated key
+// resolves to its first occurrence.
+template<size_t SlotCount, size_t BucketCount, size_t N>
+consteval PerfectHash<SlotCount, BucketCount> makePerfectHash(
+    const std::array<std::string_view, N>& keys) {
+    using Table = PerfectHash<SlotCount, BucketCount>;
+    for(uint64_t seed = 0; seed < 64; ++seed) {
+        Table table;
+        table.seed = seed;
+        std::array<uint64_t, N> hashes{};
+        std::array<size_t, BucketCount> sizes{};
+        for(size_t i = 0; i < N; ++i) {
+            if(keys[i].empty())
+                continue;
+            hashes[i] = hashName(keys[i], seed);
+            ++sizes[Table::bucket(hashes[i])];
+        }
+        std::array<size_t, N> members{};
+        bool placed = true;
+        // Larger buckets are placed first, while the table is still empty.
+        for(size_t size = N; size > 0 && placed; --size) {
+            for(size_t b = 0; b < BucketCount && placed; ++b) {
+                if(sizes[b] != size)
+                    continue;
+                size_t count = 0;
+                for(size_t i = 0; i < N; ++i) {
+                    if(!keys[i].empty() && Table::bucket(hashes[i]) == b)
+                        members[count++] = i;
+                }
+                placed = false;
+                for(uint32_t d = 0; d < SlotCount && !placed; ++d) {
+                    size_t done = 0;
+                    for(; done < count; ++done) {
+                        auto key = members[done];
+                        auto& slot = table.slots[Table::slot(hashes[key], d)];
+                        if(!slot)
+                            slot = key + 1;
+                        // A repeated key lands on its first occurrence.
+                        else if(keys[slot - 1] != keys[key])
+                            break;
+                    }
+                    placed = done == count;
+                    if(placed)
+                        table.displacements[b] = d;
+                    while(!placed && done-- > 0) {
+                        auto key = members[done];
+                        auto& slot = table.slots[Table::slot(hashes[key], d)];
+                        if(slot == key + 1)
+                            slot = 0;
+                    }
+                }
+            }
+        }
+        if(placed)
+            return table;
+    }
+    throw "no perfect hash found";
+}
+
+template<class T>
+struct OptionTraits {
+    static constexpr OptionType type = OptionType::param;
+};
+template<>
+struct OptionTraits<bool> {
+    static constexpr OptionType type = OptionType::flag;
+};
+template<class T, class Alloc>
+struct OptionTraits<std::vector<T, Alloc>> {
+    static constexpr OptionType type = OptionType::list;
+};
+
+} // namespace detail
+
+// Option descriptor for StaticParser, the arguments mean the same as for
+// CommandLineParser::add(). bool options are flags, std::vector options are
+// lists:
+//   StaticParser<
+//       Opt<"help,h", bool, "print help">,
+//       Opt<"+compression,c,level", std::optional<int>, "compression level">,
+//       Opt<"+,,path", std::vector<std::string_view>, "file path(s)", -1>>
+template<
+    detail::FixedString Spec, class T, detail::FixedString Help = "",
+    int Position = 0>
+struct Opt {
+    using type = T;
+    static constexpr OptionSpec spec = OptionSpec(Spec.view());
+    static constexpr detail::OptionInfo info{
+        detail::OptionTraits<T>::type, spec.required, spec.name, spec.flags,
+        Help.view(), spec.hint, Position};
+};
+
+// Parser for a schema fixed at compile time. Values are stored in the parser
+// with their own types, lookup tables are constant data and option values
+// are converted through a switch over the option index, so the whole parse
+// can be inlined. Command line syntax and help output are the same as for
+// CommandLineParser.
+template<class... Opts>
+class StaticParser {
+    using OptionType = detail::OptionType;
+    using Option = detail::OptionInfo;
+    static constexpr size_t optionCount = sizeof...(Opts);
+    static constexpr std::array<Option, optionCount> options_{Opts::info...};
+    static constexpr OptionSpec specs_[] = {Opts::spec..., OptionSpec()};
+    static_assert(uniqueSpecs(specs_));
+
+    struct FlagTable {
+        // Short flag character to option index + 1, 0 is unknown.
+        std::array<uint32_t, 256> index{};
+        // Short flag characters bound to boolean flag options.
+        detail::CharMask mask;
+    };
+    static consteval FlagTable makeFlagTable() {
+        FlagTable table;
+        for(size_t i = 0; i < optionCount; ++i) {
+            for(auto c : options_[i].flags) {
+                table.index[static_cast<unsigned char>(c)] = i + 1;
+                if(options_[i].type == OptionType::flag)
+                    table.mask.set(c);
+            }
+        }
+        return table;
+    }
+    static constexpr FlagTable flagTable_ = makeFlagTable();
+
+    static consteval size_t maxPosition() {
+        size_t result = 0;
+        for(auto& opt : options_) {
+            if(opt.position > 0 && static_cast<size_t>(opt.position) > result)
+                result = opt.position;
+        }
+        return result;
+    }
+    // Positional argument number to option index + 1. Unbound slots, slot 0
+    // and positions past the table go to the catch-all option.
+    static consteval std::array<uint32_t, maxPosition() + 1> makePositions() {
+        std::array<uint32_t, maxPosition() + 1> table{};
+        uint32_t catchAll = 0;
+        for(size_t i = 0; i < optionCount; ++i) {
+            if(options_[i].position == -1)
+                catchAll = i + 1;
+        }
+        for(auto& slot : table)
+            slot = catchAll;
+        for(size_t i = optionCount; i-- > 0;) {
+            if(options_[i].position > 0)
+                table[options_[i].position] = i + 1;
+        }
+        return table;
+    }
+    static constexpr auto positions_ = makePositions();
+    static constexpr auto names_ = [] {
+        std::array<std::string_view, optionCount> names;
+        for(size_t i = 0; i < optionCount; ++i)
+            names[i] = options_[i].name;
+        return names;
+    }();
+    static constexpr auto nameTable_ = detail::makePerfectHash<
+        detail::perfectHashSlots<optionCount>,
+        detail::perfectHashBuckets<optionCount>>(names_);
+    static constexpr bool hasPosArg_ = [] {
+        for(auto& opt : options_) {
+            if(opt.position)
+                return true;
+        }
+        return false;
+    }();
+
+    template<detail::FixedString Name>
+    static consteval size_t indexOf() {
+        for(size_t i = 0; i < optionCount; ++i) {
+            auto& opt = options_[i];
+            if(opt.name == Name.view()
+               || (opt.name.empty() && opt.flags.empty()
+                   && opt.hint == Name.view()))
+                return i;
+        }
+        throw "no option with this name";
+    }
+
+public:
+    template<size_t I>
+    auto& get() {
+        return std::get<I>(values_);
+    }
+    template<size_t I>
+    const auto& get() const {
+        return std::get<I>(values_);
+    }
+    // Value of the option with a long name, or a hint for positional ones.
+    template<detail::FixedString Name>
+    auto& get() {
+        return std::get<indexOf<Name>()>(values_);
+    }
+    template<detail::FixedString Name>
+    const auto& get() const {
+        return std::get<indexOf<Name>()>(values_);
+    }
+
+    StaticParser& setProgram(std::string_view name) {
+        program_ = name;
+        return *this;
+    }
+    StaticParser& skipUnknown(bool value = true) {
+        skipUnknown_ = value;
+        return *this;
+    }
+    bool skipUnknown() const {
+        return skipUnknown_;
+    }
+    const std::string& error() const {
+        return error_.message();
+    }
+    const ParseErrorInfo& errorInfo() const {
+        return error_.info();
+    }
+    size_t formatError(char* data, size_t size) const {
+        return error_.format(data, size);
+    }
+
+    // Same as CommandLineParser::reset().
+    void reset() {
+        parsed_.fill(false);
+        resetValues(std::index_sequence_for<Opts...>{});
+        error_.clear();
+    }
+    bool checkRequired() {
+        for(size_t i = 0; i < optionCount; ++i) {
+            if(!options_[i].required || parsed_[i])
+                continue;
+            error_.set(
+                ParseError::requiredMissing, 0, options_[i].name, options_[i],
+                i);
+            return false;
+        }
+        return true;
+    }
+    bool parse(int argc, char** argv) {
+        return detail::parseArgv(*this, error_, argc, argv);
+    }
+    // Same as CommandLineParser::parse(Args&&).
+    template<detail::ArgRange Args>
+    bool parse(Args&& args) {
+        return detail::parseArgs(*this, error_, std::forward<Args>(args));
+    }
+
+    std::string getHelp() const {
+        return detail::formatHelp(program_, options_);
+    }
+
+private:
+    template<class Parser, class Args>
+    friend bool detail::parseArgs(Parser&, detail::ErrorState&, Args&&);
+    template<class Parser>
+    friend bool detail::parseArgv(Parser&, detail::ErrorState&, int, char**);
+
+    static const Option* findOption(int position) {
+        uint32_t index = positions_[0];
+        if(static_cast<size_t>(position) < positions_.size())
+            index = positions_[position];
+        return index ? &options_[index - 1] : nullptr;
+    }
+    static const Option* findOption(char optChar) {
+        auto index = flagTable_.index[static_cast<unsigned char>(optChar)];
+        return index ? &options_[index - 1] : nullptr;
+    }
+    static const Option* findOption(std::string_view name) {
+        auto index = nameTable_.find(name);
+        if(!index || options_[index - 1].name != name)
+            return nullptr;
+        return &options_[index - 1];
+    }
+    static bool hasPosArg() {
+        return hasPosArg_;
+    }
+    static bool isFlagCluster(std::string_view chars) {
+        return flagTable_.mask.all(chars);
+    }
+    bool parseOption(const Option& opt, std::string_view value) {
+        size_t index = indexOf(opt);
+        parsed_[index] = true;
+        return dispatch(index, value, std::index_sequence_for<Opts...>{});
+    }
+    void setFlag(const Option& opt) {
+        parseOption(opt, {});
+    }
+    bool isParsed(const Option& opt) const {
+        return parsed_[indexOf(opt)];
+    }
+    static size_t indexOf(const Option& opt) {
+        return &opt - options_.data();
+    }
+    static const Option& infoOf(const Option& opt) {
+        return opt;
+    }
+
+    template<size_t... I>
+    bool dispatch(
+        size_t index, std::string_view value, std::index_sequence<I...>) {
+        bool result = false;
+        ((index == I && (result = parseValue<I>(value), true)) || ...);
+        return result;
+    }
+    template<size_t... I>
+    void resetValues(std::index_sequence<I...>) {
+        (resetValue<I>(), ...);
+    }
+    template<size_t I>
+    void resetValue() {
+        if constexpr(options_[I].type == OptionType::flag)
+            std::get<I>(values_) = false;
+        else if constexpr(options_[I].type == OptionType::list)
+            std::get<I>(values_).clear();
+    }
+    template<size_t I>
+    bool parseValue(std::string_view value) {
+        auto& target = std::get<I>(values_);
+        if constexpr(options_[I].type == OptionType::flag) {
+            target = true;
+            return true;
+        }
+        else if constexpr(options_[I].type == OptionType::list) {
+            // A value that fails to convert is not added.
+            using Item =
+                typename std::remove_reference_t<decltype(target)>::value_type;
+            Item item{};
+            if(!detail::parse(value, item))
+                return false;
+            target.push_back(std::move(item));
+            return true;
+        }
+        else
+            return detail::parse(value, target);
+    }
+
+private:
+    std::string_view program_;
+    bool skipUnknown_ = false;
+    std::tuple<typename Opts::type...> values_;
+    std::array<bool, optionCount> parsed_{};
+    detail::ErrorState error_;
+};
+
+// Front end of a multi-call binary installed under many names, busybox
+// style. The name the binary was run as selects one of the Names applets
+// through a perfect hash built at compile time, and only that applet's
+// options are registered:
+//   MultiCall<"ls", "cat"> tool;
+//   tool.add<"ls">([&](CommandLineParser& p) { p.addFlag(all, "all,a"); });
+//   if(!tool.parse(argc, argv))
+//       log(tool.error());
+// Run under another name, e.g. as the binary itself, the first argument
+// names the applet instead and errors count arguments from argv as given.
+template<detail::FixedString... Names>
+class MultiCall {
+    static constexpr size_t appletCount = sizeof...(Names);
+    static constexpr std::array<std::string_view, appletCount> names_{
+        Names.view()...};
+    static constexpr auto nameTable_ = detail::makePerfectHash<
+        detail::perfectHashSlots<appletCount>,
+        detail::perfectHashBuckets<appletCount>>(names_);
+
+public:
+    using Factory = CommandLineParser::CommandFactory;
+
+    // Index of the applet, -1 if there is none with this name.
+    static constexpr int find(std::string_view name) {
+        auto index = nameTable_.find(name);
+        if(!index || names_[index - 1] != name)
+            return -1;
+        return static_cast<int>(index - 1);
+    }
+
+    // Sets the function that registers the options of an applet.
+    template<detail::FixedString Name>
+    MultiCall& add(Factory factory) {
+        constexpr int index = find(Name.view());
+        static_assert(index >= 0, "no applet with this name");
+        factories_[index] = std::move(factory);
+        return *this;
+    }
+
+    bool parse(int argc, char** argv) {
+        std::string_view name;
+        if(argc > 0)
+            name = detail::programName(argv[0]);
+        int index = find(name);
+        // Index in argv of the applet name.
+        int argIndex = 0;
+        if(index < 0 && argc > 1) {
+            ++argv;
+            --argc;
+            name = argv[0];
+            index = find(name);
+            argIndex = 1;
+        }
+        if(index < 0 || !factories_[index]) {
+            parser_.reset();
+            applet_ = -1;
+            error_.set(ParseError::unknownCommand, argIndex, name);
+            return false;
+        }
+        if(!parser_ || applet_ != index) {
+            parser_.emplace();
+            factories_[index](*parser_);
+            applet_ = index;
+        }
+        if(parser_->parse(argc, argv))
+            return true;
+        parser_->offsetArgIndex(argIndex);
+        return false;
+    }
+
+    // Name of the selected applet, empty if none.
+    std::string_view applet() const {
+        return applet_ < 0 ? std::string_view() : names_[applet_];
+    }
+    // Parser of the selected applet, nullptr if none.
+    CommandLineParser* parser() {
+        return parser_ ? &*parser_ : nullptr;
+    }
+    const std::string& error() const {
+        return parser_ ? parser_->error() : error_.message();
+    }
+    const ParseErrorInfo& errorInfo() const {
+        return parser_ ? parser_->errorInfo() : error_.info();
+    }
+
+private:
+    std::array<Factory, appletCount> factories_;
+    std::optional<CommandLineParser> parser_;
+    int applet_ = -1;
+    detail::ErrorState error_;
+};
+
+} // namespace univang